@@ -1,27 +1,34 @@
 #include "ai.h"
-#include "instrument/metaparameter.h"
+#include "genome.h"
 #include <algorithm>
-#include <random>
 
 namespace ai {
 
-Individual Individual::create_random()
+Individual Individual::create_random(Xoshiro256 &prng)
 {
     Individual x;
-    FmBank::Instrument &ins = x.ins_;
-
-    std::mt19937_64 prng{std::random_device{}()};
-
-    for (const MetaParameter &mp : MP_instrument) {
-        if (mp.flags & MP_NotAIFeature)
-            continue;
+    InstrumentGeneOps::randomize(x.genes_, prng);
+    return x;
+}
 
-        std::uniform_int_distribution<int> dist(mp.min, mp.max);
+Individual Individual::from_instrument(const FmBank::Instrument &ins)
+{
+    Individual x;
+    InstrumentGeneOps::from_instrument(x.genes_, ins);
+    return x;
+}
 
-        mp.set(ins, dist(prng));
-    }
+FmBank::Instrument Individual::instrument() const
+{
+    FmBank::Instrument ins;
+    to_instrument(ins);
+    return ins;
+}
 
-    return x;
+void Individual::to_instrument(FmBank::Instrument &ins) const
+{
+    ins = FmBank::emptyInst();
+    InstrumentGeneOps::to_instrument(genes_, ins);
 }
 
 Population Population::create_empty(size_t capacity)
@@ -35,11 +42,11 @@ Population Population::create_empty(size_t capacity)
     return pop;
 }
 
-Population Population::create_random(size_t size)
+Population Population::create_random(size_t size, Xoshiro256 &prng)
 {
     Population pop = create_empty(size);
     for (size_t i = 0; i < size; ++i)
-        pop.replace_member(i, Individual::create_random());
+        pop.replace_member(i, Individual::create_random(prng));
     return pop;
 }
 
@@ -50,10 +57,10 @@ size_t Population::add_member(const Individual &ind)
     if (size == capacity_)
         return ~(size_t)0;
 
-    #pragma message("XXX inefficient")
     size_t index = std::distance(&status_[0],
-        std::find(&status_[0], &status_[size], Absent));
+        std::find(&status_[first_absent_], &status_[capacity_], Absent));
 
+    first_absent_ = index + 1;
     size_ = size + 1;
     members_[index] = ind;
     status_[index] = Unevaluated;
@@ -75,6 +82,7 @@ bool Population::remove_member(size_t index)
         return false;
 
     status_[index] = Absent;
+    first_absent_ = std::min(first_absent_, index);
     --size_;
     return true;
 }
@@ -104,6 +112,17 @@ bool Population::set_evaluation(size_t index, double ev)
     return true;
 }
 
+bool Population::set_evaluation(size_t index, double ev, bool complete)
+{
+    if (!complete) {
+        if (status_[index] == Absent)
+            return false;
+        status_[index] = Unevaluated;
+        return true;
+    }
+    return set_evaluation(index, ev);
+}
+
 double Population::get_evaluation(size_t index)
 {
     if (status_[index] != Evaluated)
@@ -112,4 +131,23 @@ double Population::get_evaluation(size_t index)
     return evaluation_[index];
 }
 
+size_t Population::compute_fitness(double *fitness)
+{
+    size_t count = capacity_;
+
+    double avg = 0;
+    for (size_t i = 0; i < count; ++i)
+        avg += get_evaluation(i);
+    avg /= count;
+
+    size_t fittest_index = 0;
+    for (size_t i = 0; i < count; ++i) {
+        double f = get_evaluation(i) / avg;
+        fitness[i] = f;
+        if (f > fitness[fittest_index])
+            fittest_index = i;
+    }
+    return fittest_index;
+}
+
 } // namespace ai
@@ -1,22 +1,49 @@
 #pragma once
 #include "instrument/bank.h"
+#include "random.h"
 #include <vector>
 #include <memory>
 #include <cstdint>
 
 namespace ai {
 
+// genes of an instrument, one byte each: the channel parameters, then those
+// of the operators in their logical order; see genome.h for their ranges
+enum Gene : unsigned {
+    gene_alg, gene_fb, gene_ams, gene_fms,
+    gene_op1,
+    num_channel_genes = gene_op1,
+};
+
+enum OperatorGene : unsigned {
+    op_ar, op_d1r, op_d2r, op_d1l, op_rr, op_tl, op_rs, op_mul, op_dt, op_am, op_ssg,
+    genes_per_operator,
+};
+
+enum { num_genes = num_channel_genes + 4 * genes_per_operator };
+
+inline constexpr unsigned operator_gene(unsigned n, OperatorGene gene)
+{
+    return gene_op1 + n * genes_per_operator + gene;
+}
+
+// the genome; what it does not have takes the values of an empty
+// instrument, when it is converted to be rendered or saved
 struct Individual
 {
-    FmBank::Instrument ins_ = FmBank::emptyInst();
+    uint8_t genes_[num_genes] = {};
 
-    static Individual create_random();
+    static Individual create_random(Xoshiro256 &prng);
+    static Individual from_instrument(const FmBank::Instrument &ins);
+
+    FmBank::Instrument instrument() const;
+    void to_instrument(FmBank::Instrument &ins) const;
 };
 
 struct Population
 {
     static Population create_empty(size_t capacity);
-    static Population create_random(size_t size);
+    static Population create_random(size_t size, Xoshiro256 &prng);
 
     size_t size() const noexcept { return size_; }
     size_t capacity() const noexcept { return capacity_; }
@@ -30,8 +57,16 @@ struct Population
 
     void clear_evaluation();
     bool set_evaluation(size_t index, double ev);
+    // the result of an evaluation which was possibly cut short at a bound;
+    // an incomplete one is only a limit of the true result, not a score, so
+    // the member is left unevaluated, below any evaluated member
+    bool set_evaluation(size_t index, double ev, bool complete);
     double get_evaluation(size_t index);
 
+    // the evaluation of every member relative to the average, which is 0
+    // for members not evaluated; returns the index of the fittest
+    size_t compute_fitness(double *fitness);
+
     enum Status : uint8_t {
         Absent = 0, Unevaluated, Evaluated,
     };
@@ -41,6 +76,9 @@ struct Population
 private:
     size_t size_ = 0;
     size_t capacity_ = 0;
+    // no absent member is found before this index
+    size_t first_absent_ = 0;
+    // the genomes are packed together, apart from the evaluations
     std::unique_ptr<Individual[]> members_;
     std::unique_ptr<double[]> evaluation_;
     std::unique_ptr<Status[]> status_;
@@ -1,18 +1,93 @@
 #include "algorithm.h"
 #include "evaluation.h"
 #include "ai.h"
-#include "instrument/metaparameter.h"
+#include "mailbox.h"
+#include "canonical.h"
+#include "genome.h"
+#include <algorithm>
 #include <random>
+#include <cmath>
 
 namespace ai {
 
+// elite sent from an island to the next
+struct Migrant
+{
+    Individual ind_;
+    double evaluation_ = 0;
+    unsigned revision_ = 0;
+};
+
+// population which evolves on its own, and what it keeps from a
+// generation to the next
+struct GeneticAlgorithm::Island
+{
+    std::unique_ptr<Population> population_;
+    Xoshiro256 prng_;
+    size_t generation_num_ = 0;
+    unsigned revision_ = 0;
+
+    // evaluations are cut short when they cannot beat the worst survivor
+    // of the previous generation, measured under the same settings
+    double eval_bound_ = 0;
+    unsigned eval_bound_revision_ = 0;
+
+    Individual fittest_;
+    double fittest_evaluation_ = 0;
+    FitnessRecord fitness_;
+
+    // elites sent to the next island, at every migration
+    enum { num_emigrants = 2 };
+    Mailbox<Migrant> mailbox_;
+
+    // buffers which persist across generations
+    std::vector<unsigned> pending_;
+    std::vector<unsigned> order_;
+    std::vector<const Individual *> selected_;
+    std::vector<Migrant> migrants_;
+};
+
+// shared state of the workers of the steady-state engine
+struct GeneticAlgorithm::SteadyState
+{
+    // what the population was when the work list was made
+    bool valid_ = false;
+    unsigned population_serial_ = 0;
+    unsigned revision_ = 0;
+
+    // members which need evaluating again, and slots taken by a worker
+    std::vector<unsigned> pending_;
+    std::vector<uint8_t> busy_;
+
+    // children born since the last generation was counted
+    size_t num_births_ = 0;
+};
+
+static Individual recombine(const Individual &i1, const Individual &i2, Xoshiro256 &prng)
+{
+    Individual combined;
+    recombine_genes(combined.genes_, i1.genes_, i2.genes_, prng);
+    return combined;
+}
+
+static bool mutate(Individual &ind, Xoshiro256 &prng)
+{
+    // genes of silent operators are not worth changing
+    uint64_t frozen = dead_genes(live_operators(ind));
+    return mutate_genes(ind.genes_, frozen, prng);
+}
+
+//
 GeneticAlgorithm::GeneticAlgorithm()
 {
     GeneticData *gdata = new GeneticData;
     gdata_.reset(gdata);
     gdata->eval_.reset(new Evaluation);
+    std::random_device device;
+    prng_.seed(((uint64_t)device() << 32) | device());
     gdata->population_.reset(
-        new Population(Population::create_random(GeneticData::population_size)));
+        new Population(Population::create_random(gdata->population_size_, prng_)));
+    pool_.reset(new ThreadPool);
 }
 
 GeneticAlgorithm::~GeneticAlgorithm()
@@ -30,9 +105,37 @@ void GeneticAlgorithm::set_fitness_callback(FitCallback callback)
     fit_callback_ = callback;
 }
 
+std::shared_ptr<const Snapshot> GeneticAlgorithm::snapshot() const
+{
+    return std::atomic_load(&snapshot_);
+}
+
+void GeneticAlgorithm::post(Command command)
+{
+    commands_.post(std::move(command));
+
+    if (!thread_.joinable()) {
+        std::unique_lock<std::mutex> lock;
+        apply_commands(this->lock(lock));
+        return;
+    }
+
+    // wake up whoever applies the commands, if it waits
+    {
+        std::lock_guard<std::mutex> lock(pause_mutex_);
+    }
+    pause_cond_.notify_all();
+}
+
 GeneticData &GeneticAlgorithm::lock(std::unique_lock<std::mutex> &lock)
 {
     lock = std::unique_lock<std::mutex>(gmutex_);
+    // islands evolve outside of the mutex, wait for them to be between
+    // two generations, and hold them there
+    ++num_writers_;
+    island_cond_.wait(lock, [this]() { return num_readers_ == 0; });
+    --num_writers_;
+    island_cond_.notify_all();
     return *gdata_;
 }
 
@@ -54,6 +157,10 @@ void GeneticAlgorithm::stop()
     quit_ = true;
     set_paused(false);
     thread_.join();
+
+    // what came after the last generation
+    std::unique_lock<std::mutex> lock;
+    apply_commands(this->lock(lock));
 }
 
 bool GeneticAlgorithm::set_paused(bool p)
@@ -61,7 +168,7 @@ bool GeneticAlgorithm::set_paused(bool p)
     std::lock_guard<std::mutex> lock(pause_mutex_);
     bool was_paused = pause_;
     pause_ = p;
-    pause_cond_.notify_one();
+    pause_cond_.notify_all();
     return was_paused;
 }
 
@@ -69,31 +176,233 @@ void GeneticAlgorithm::toggle_paused()
 {
     std::lock_guard<std::mutex> lock(pause_mutex_);
     pause_ = !pause_;
-    pause_cond_.notify_one();
+    pause_cond_.notify_all();
 }
 
 void GeneticAlgorithm::reinitialize()
 {
+    post([this](GeneticData &gdata) { reinitialize_population(gdata); });
+}
+
+void GeneticAlgorithm::set_population_size(size_t size)
+{
+    post([this, size](GeneticData &gdata) { resize_population(gdata, size); });
+}
+
+void GeneticAlgorithm::reinitialize_population(GeneticData &gdata)
+{
+    gdata.population_.reset(
+        new Population(Population::create_random(gdata.population_size_, prng_)));
+    gdata.generation_num_ = 0;
+    ++population_serial_;
+    if (!islands_.empty())
+        split_islands();
+}
+
+void GeneticAlgorithm::resize_population(GeneticData &gdata, size_t size)
+{
+    size = std::max<size_t>(size, GeneticData::min_population_size);
+    size = std::min<size_t>(size, GeneticData::max_population_size);
+    size = std::max<size_t>(size, islands_.size() * GeneticData::min_population_size);
+    if (gdata.population_size_ == size)
+        return;
+
+    if (!islands_.empty())
+        merge_islands();
+    // keep the members which fit, and fill up with random ones
+    Population &old = *gdata.population_;
     std::unique_ptr<Population> pop(
-        new Population(Population::create_random(GeneticData::population_size)));
+        new Population(Population::create_empty(size)));
+    for (size_t i = 0, n = std::min(size, old.capacity()); i < n; ++i) {
+        if (const Individual *member = old.get_member(i)) {
+            pop->replace_member(i, *member);
+            if (old.get_status(i) == Population::Evaluated)
+                pop->set_evaluation(i, old.get_evaluation(i));
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (!pop->get_member(i))
+            pop->replace_member(i, Individual::create_random(prng_));
+    }
+    gdata.population_ = std::move(pop);
+    gdata.population_size_ = size;
+    population_size_ = size;
+    ++population_serial_;
+    if (!islands_.empty())
+        split_islands();
+}
+
+void GeneticAlgorithm::apply_commands(GeneticData &gdata)
+{
+    commands_.receive([&gdata](Command &&command) { command(gdata); });
+}
 
-    bool was_paused = set_paused(true);
+// the thread of exec() does this while other threads evolve
+void GeneticAlgorithm::serve_commands()
+{
+    volatile bool *quit = &quit_;
+
+    while (!*quit) {
+        {
+            std::unique_lock<std::mutex> lock(pause_mutex_);
+            pause_cond_.wait(lock, [this, quit]() { return *quit || !commands_.empty(); });
+        }
+        std::unique_lock<std::mutex> lock;
+        apply_commands(this->lock(lock));
+    }
+}
+
+void GeneticAlgorithm::publish(size_t generation_num, const Individual &fittest, double fittest_evaluation, const FitnessRecord &fitness)
+{
+    std::shared_ptr<Snapshot> snapshot(new Snapshot);
+    snapshot->generation_num_ = generation_num;
+    snapshot->fittest_ = fittest;
+    snapshot->fittest_evaluation_ = fittest_evaluation;
+    snapshot->fitness_ = fitness;
+    std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+}
+
+void GeneticAlgorithm::set_num_threads(unsigned num_threads)
+{
+    // the pool is replaced between two generations of every thread
+    std::unique_lock<std::mutex> lock;
+    this->lock(lock);
+    if (pool_ && num_threads != 0 && pool_->size() == num_threads)
+        return;
+    pool_.reset();
+    pool_.reset(new ThreadPool(num_threads));
+}
+
+void GeneticAlgorithm::set_num_islands(unsigned num_islands)
+{
+    std::lock_guard<std::mutex> lock(gmutex_);
+    num_islands_ = num_islands;
+}
+
+void GeneticAlgorithm::set_steady_state(bool steady)
+{
+    std::lock_guard<std::mutex> lock(gmutex_);
+    steady_state_ = steady;
+}
+
+void GeneticAlgorithm::set_seed(uint64_t seed)
+{
+    std::unique_lock<std::mutex> lock;
+    this->lock(lock);
+    prng_.seed(seed);
+}
+
+void GeneticAlgorithm::set_migration_interval(unsigned num_generations)
+{
     std::lock_guard<std::mutex> lock(gmutex_);
-    gdata_->population_ = std::move(pop);
-    gdata_->generation_num_ = 0;
-    set_paused(was_paused);
+    migration_interval_ = std::max(1u, num_generations);
+}
+
+void GeneticAlgorithm::set_task_granularity(unsigned num_batches)
+{
+    std::lock_guard<std::mutex> lock(gmutex_);
+    task_granularity_ = std::max(1u, num_batches);
 }
 
 void GeneticAlgorithm::exec()
 {
+    bool steady_state;
+    unsigned num_islands;
+    {
+        std::lock_guard<std::mutex> lock(gmutex_);
+        steady_state = steady_state_;
+        num_islands = (unsigned)std::min<size_t>(
+            num_islands_, gdata_->population_size_ / GeneticData::min_population_size);
+    }
+    if (steady_state) {
+        exec_steady();
+        return;
+    }
+    if (num_islands > 1) {
+        exec_islands(num_islands);
+        return;
+    }
+
     volatile bool *quit = &quit_;
     volatile bool *pause = &pause_;
     GeneticData &gdata = *gdata_;
 
-    std::mt19937_64 prng{std::random_device{}()};
-    static constexpr unsigned pop_size = GeneticData::population_size;
+    // the population of the shared data, evaluated on the thread pool
+    Island island;
+    {
+        std::lock_guard<std::mutex> lock(gmutex_);
+        island.prng_ = prng_.split();
+    }
+
+    while (!*quit) {
+        if (*pause) {
+            std::unique_lock<std::mutex> lock(pause_mutex_);
+            if (*pause && commands_.empty()) {
+                pause_cond_.wait(lock);
+                continue;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(gmutex_);
+
+        apply_commands(gdata);
+        if (*pause)
+            continue;
+
+        island.generation_num_ = gdata.generation_num_;
+        Outcome outcome = generation(*gdata.population_, island, *gdata.eval_, nullptr, true);
+        if (outcome == Quit)
+            return;
+
+        if (outcome == Evolved) {
+            publish(island.generation_num_, island.fittest_, island.fittest_evaluation_, island.fitness_);
+            if (fit_callback_)
+                fit_callback_(island.generation_num_, island.fitness_);
+            if (gen_callback_)
+                gen_callback_(island.generation_num_, island.fittest_);
+        }
+
+        gdata.generation_num_ = island.generation_num_ + 1;
+    }
+}
+
+void GeneticAlgorithm::exec_islands(unsigned num_islands)
+{
+    {
+        std::unique_lock<std::mutex> lock;
+        this->lock(lock);
+        for (unsigned i = 0; i < num_islands; ++i) {
+            islands_.emplace_back(new Island);
+            islands_.back()->prng_ = prng_.split();
+        }
+        split_islands();
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_islands);
+    for (unsigned i = 0; i < num_islands; ++i)
+        threads.emplace_back([this, i]() { run_island(i); });
+    serve_commands();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    {
+        std::unique_lock<std::mutex> lock;
+        this->lock(lock);
+        merge_islands();
+        islands_.clear();
+    }
+}
+
+void GeneticAlgorithm::run_island(unsigned index)
+{
+    volatile bool *quit = &quit_;
+    volatile bool *pause = &pause_;
+    GeneticData &gdata = *gdata_;
 
-    ai::Individual fittest_ind;
+    // elites go around the ring of islands
+    Island &island = *islands_[index];
+    Island &neighbor = *islands_[(index + 1) % islands_.size()];
 
     while (!*quit) {
         if (*pause) {
@@ -104,155 +413,463 @@ void GeneticAlgorithm::exec()
             }
         }
 
+        // evolve without the mutex, but as a reader which lock() waits for
         std::unique_lock<std::mutex> lock(gmutex_);
+        island_cond_.wait(lock, [this]() { return num_writers_ == 0; });
+        ++num_readers_;
+        lock.unlock();
 
-        ai::Population &pop = *gdata.population_;
-        ai::Evaluation &eval = *gdata.eval_;
-        size_t generation_num = gdata.generation_num_;
+        Outcome outcome = generation(*island.population_, island, *gdata.eval_, &neighbor, false);
 
-        /* Evaluation */
-        #pragma omp parallel for
-        for (unsigned i = 0; i < pop_size; ++i) {
-            if (!*quit && pop.get_status(i) != Population::Evaluated) {
-                const ai::Individual &ind = *pop.get_member(i);
-                pop.set_evaluation(i, eval.evaluate(ind.ins_));
+        lock.lock();
+        if (--num_readers_ == 0)
+            island_cond_.notify_all();
+        if (outcome == Quit)
+            return;
+
+        // report the fittest of all islands
+        if (outcome == Evolved) {
+            unsigned revision = gdata.eval_->revision();
+            if (best_revision_ != revision || island.fittest_evaluation_ > best_evaluation_) {
+                best_ = island.fittest_;
+                best_evaluation_ = island.fittest_evaluation_;
+                best_revision_ = revision;
             }
+            publish(island.generation_num_, best_, best_evaluation_, island.fitness_);
+            if (fit_callback_)
+                fit_callback_(island.generation_num_, island.fitness_);
+            if (gen_callback_)
+                gen_callback_(island.generation_num_, best_);
         }
 
-        if (*quit)
-            return;
+        ++island.generation_num_;
+        gdata.generation_num_ = std::max(gdata.generation_num_, island.generation_num_);
+    }
+}
 
-        /* Fitness */
-        FitnessRecord fitness_record;
-        double *fitness = fitness_record.data;
-        unsigned fittest_index = 0;
-        {
-            double avg = 0;
-            for (unsigned i = 0; i < pop_size; ++i)
-                avg += pop.get_evaluation(i);
-            avg /= GeneticData::population_size;
+void GeneticAlgorithm::exec_steady()
+{
+    std::vector<Xoshiro256> streams;
+    {
+        std::unique_lock<std::mutex> lock;
+        this->lock(lock);
+        steady_.reset(new SteadyState);
+        for (unsigned i = 0, n = pool_->size(); i < n; ++i)
+            streams.push_back(prng_.split());
+    }
 
-            for (unsigned i = 0; i < pop_size; ++i) {
-                double f = pop.get_evaluation(i) / avg;
-                fitness[i] = f;
-                if (f > fitness[fittest_index])
-                    fittest_index = i;
+    std::vector<std::thread> threads;
+    threads.reserve(streams.size());
+    for (const Xoshiro256 &prng : streams)
+        threads.emplace_back([this, prng]() { run_steady_worker(prng); });
+    serve_commands();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    {
+        std::unique_lock<std::mutex> lock;
+        this->lock(lock);
+        steady_.reset();
+    }
+}
+
+void GeneticAlgorithm::run_steady_worker(Xoshiro256 prng)
+{
+    volatile bool *quit = &quit_;
+    volatile bool *pause = &pause_;
+    GeneticData &gdata = *gdata_;
+    SteadyState &steady = *steady_;
+
+    // a batch has children, which take the slots of weak members if they
+    // do better, and members which need evaluating again in their slots
+    static constexpr unsigned batch_size = Evaluation::max_batch;
+    unsigned slots[batch_size];
+    bool is_child[batch_size];
+    Individual inds[batch_size];
+    double results[batch_size];
+
+    while (!*quit) {
+        if (*pause) {
+            std::unique_lock<std::mutex> lock(pause_mutex_);
+            if (*pause) {
+                pause_cond_.wait(lock);
+                continue;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(gmutex_);
+        island_cond_.wait(lock, [this]() { return num_writers_ == 0; });
+
+        Population &pop = *gdata.population_;
+        Evaluation &eval = *gdata.eval_;
+        const unsigned pop_size = (unsigned)pop.capacity();
+
+        // the work list is made again after the settings or the population
+        // have changed, which happens only with no batch in progress
+        if (!steady.valid_ || steady.population_serial_ != population_serial_ ||
+            steady.revision_ != eval.revision()) {
+            steady.valid_ = true;
+            steady.population_serial_ = population_serial_;
+            steady.revision_ = eval.revision();
+            steady.pending_.clear();
+            for (unsigned i = pop_size; i-- > 0;) {
+                if (pop.get_status(i) != Population::Evaluated)
+                    steady.pending_.push_back(i);
             }
+            steady.busy_.assign(pop_size, 0);
         }
-        fittest_ind = *pop.get_member(fittest_index);
 
-        if (fit_callback_)
-            fit_callback_(generation_num, fitness_record);
+        unsigned count = 0;
+        while (count < batch_size && !steady.pending_.empty()) {
+            unsigned i = steady.pending_.back();
+            steady.pending_.pop_back();
+            const Individual *member = pop.get_member(i);
+            if (!member || steady.busy_[i] || pop.get_status(i) == Population::Evaluated)
+                continue;
+            slots[count] = i;
+            is_child[count] = false;
+            inds[count] = *member;
+            steady.busy_[i] = 1;
+            ++count;
+        }
 
-        if (*quit)
-            return;
+        auto pick = [&prng, pop_size]() -> unsigned { return prng.below(pop_size); };
+        for (unsigned tries = 0; count < batch_size && tries < 4 * batch_size; ++tries) {
+            // the weaker of two evaluated members makes room for a child
+            unsigned v1 = pick(), v2 = pick();
+            bool ok1 = !steady.busy_[v1] && pop.get_status(v1) == Population::Evaluated;
+            bool ok2 = !steady.busy_[v2] && pop.get_status(v2) == Population::Evaluated;
+            if (!ok1 && !ok2)
+                continue;
+            unsigned victim = (!ok2 || (ok1 && pop.get_evaluation(v1) < pop.get_evaluation(v2))) ? v1 : v2;
 
-        /* Selection */
-        {
-            Population next = Population::create_empty(pop_size);
-            {
-                for (unsigned i = 0; i < pop_size; ++i) {
-                    double f = fitness[i];
-                    if (f >= 1.0) {
-                        next.replace_member(i, *pop.get_member(i));
-                        next.set_evaluation(i, pop.get_evaluation(i));
-                    }
-                }
-                for (unsigned i = 0; i < pop_size; ++i) {
-                    for (double f = fitness[i]; f > 1.0 && !next.full(); f -= 1.0) {
-                        double p = std::uniform_real_distribution<double>(0.0, 1.0)(prng);
-                        if (p < f) {
-                            size_t index = next.add_member(*pop.get_member(i));
-                            next.set_evaluation(index, pop.get_evaluation(i));
-                        }
-                    }
-                }
-                if (next.empty()) {
-                    /* Kill */
-                    pop = Population::create_random(pop_size);
-                    gdata.generation_num_ = generation_num + 1;
-                    continue;
-                }
+            // the stronger of two members is a parent, twice
+            unsigned parents[2];
+            for (unsigned &parent : parents) {
+                unsigned p1 = pick(), p2 = pick();
+                parent = (pop.get_evaluation(p1) >= pop.get_evaluation(p2)) ? p1 : p2;
             }
-            pop = std::move(next);
+            const Individual *i1 = pop.get_member(parents[0]);
+            const Individual *i2 = pop.get_member(parents[1]);
+            if (!i1 || !i2)
+                continue;
+
+            Individual child = recombine(*i1, *i2, prng);
+            mutate(child, prng);
+
+            slots[count] = victim;
+            is_child[count] = true;
+            inds[count] = child;
+            steady.busy_[victim] = 1;
+            ++count;
         }
 
-        if (*quit)
-            return;
+        if (count == 0) {
+            // every slot is taken, wait for a batch to finish; or else,
+            // evaluations were cleared behind our back, look for them
+            if (num_readers_ > 0)
+                island_cond_.wait(lock);
+            else
+                steady.valid_ = false;
+            continue;
+        }
 
-        /* Recombination */
-        if (!pop.full()) {
-            size_t num_selected = 0;
-            const Individual *selected[GeneticData::population_size];
+        // children are cut short if they cannot beat the members they would
+        // replace, but other members need a full evaluation
+        double eval_bound = HUGE_VAL;
+        for (unsigned j = 0; j < count; ++j)
+            eval_bound = is_child[j] ? std::min(eval_bound, pop.get_evaluation(slots[j])) : 0;
 
-            for (size_t i = 0; i < GeneticData::population_size; ++i) {
-                if (const Individual *member = pop.get_member(i))
-                    selected[num_selected++] = member;
-            }
+        ++num_readers_;
+        lock.unlock();
 
-            for (size_t i = 0; i < GeneticData::population_size; ++i) {
-                if (pop.get_member(i))
-                    continue;
-
-                const ai::Individual &i1 = *selected[std::uniform_int_distribution<size_t>(0, num_selected - 1)(prng)];
-                const ai::Individual &i2 = *selected[std::uniform_int_distribution<size_t>(0, num_selected - 1)(prng)];
-                ai::Individual combined = i1;
-
-                for (const MetaParameter &mp : MP_instrument) {
-                    if (mp.flags & MP_NotAIFeature)
-                        continue;
-                    int val1 = mp.get(i1.ins_);
-                    int val2 = mp.get(i2.ins_);
-                    if (mp.flags & MP_Bits) {
-                        /* Bitwise recombination */
-                        unsigned v = 0;
-                        for (unsigned bit = 1, max = mp.max; bit <= max; bit <<= 1) {
-                            double p = std::uniform_real_distribution<double>(0.0, 1.0)(prng);
-                            v |= (p < 0.5) ? (val1 & bit) : (val2 & bit);
-                        }
-                        mp.set(combined.ins_, v);
-                    }
-                    else {
-                        /* Linear recombination */
-                        double p = std::uniform_real_distribution<double>(0.0, 1.0)(prng);
-                        double v = val1 * p + val2 * (1 - p);
-                        mp.set(combined.ins_, std::lround(v));
-                    }
+        FmBank::Instrument batch[batch_size];
+        const FmBank::Instrument *ins[batch_size];
+        for (unsigned j = 0; j < count; ++j) {
+            inds[j].to_instrument(batch[j]);
+            ins[j] = &batch[j];
+        }
+        eval.evaluate_batch(ins, count, results, eval_bound);
+
+        lock.lock();
+        --num_readers_;
+        island_cond_.notify_all();
+
+        for (unsigned j = 0; j < count; ++j) {
+            unsigned i = slots[j];
+            steady.busy_[i] = 0;
+            if (!is_child[j])
+                pop.set_evaluation(i, results[j]);
+            else {
+                ++steady.num_births_;
+                if (results[j] > pop.get_evaluation(i)) {
+                    pop.replace_member(i, inds[j]);
+                    pop.set_evaluation(i, results[j]);
                 }
-
-                pop.replace_member(i, combined);
             }
         }
 
-        if (*quit)
-            return;
+        // as many births as members count as a generation
+        if (steady.num_births_ >= pop_size) {
+            steady.num_births_ -= pop_size;
+            size_t generation_num = gdata.generation_num_;
+
+            FitnessRecord fitness_record;
+            fitness_record.data.resize(pop_size);
+            size_t fittest_index = pop.compute_fitness(fitness_record.data.data());
 
-        /* Mutation */
+            const Individual &fittest = *pop.get_member(fittest_index);
+            publish(generation_num, fittest, pop.get_evaluation(fittest_index), fitness_record);
+            if (fit_callback_)
+                fit_callback_(generation_num, fitness_record);
+            if (gen_callback_)
+                gen_callback_(generation_num, fittest);
+
+            gdata.generation_num_ = generation_num + 1;
+        }
+    }
+}
+
+void GeneticAlgorithm::split_islands()
+{
+    GeneticData &gdata = *gdata_;
+    Population &whole = *gdata.population_;
+    size_t size = whole.capacity();
+    size_t num_islands = islands_.size();
+
+    for (size_t k = 0, index = 0; k < num_islands; ++k) {
+        Island &island = *islands_[k];
+        size_t island_size = size / num_islands + (k < size % num_islands);
+        std::unique_ptr<Population> pop(
+            new Population(Population::create_empty(island_size)));
+        for (size_t i = 0; i < island_size; ++i, ++index) {
+            const Individual *member = whole.get_member(index);
+            pop->replace_member(i, member ? *member : Individual::create_random(prng_));
+            if (whole.get_status(index) == Population::Evaluated)
+                pop->set_evaluation(i, whole.get_evaluation(index));
+        }
+        island.population_ = std::move(pop);
+        island.generation_num_ = gdata.generation_num_;
+        island.eval_bound_ = 0;
+        island.mailbox_.clear();
+    }
+
+    best_evaluation_ = 0;
+}
+
+void GeneticAlgorithm::merge_islands()
+{
+    GeneticData &gdata = *gdata_;
+    size_t size = 0;
+    for (const std::unique_ptr<Island> &island : islands_)
+        size += island->population_->capacity();
+
+    std::unique_ptr<Population> whole(
+        new Population(Population::create_empty(size)));
+    size_t index = 0;
+    for (const std::unique_ptr<Island> &island : islands_) {
+        Population &pop = *island->population_;
+        for (size_t i = 0, n = pop.capacity(); i < n; ++i, ++index) {
+            const Individual *member = pop.get_member(i);
+            whole->replace_member(index, member ? *member : Individual::create_random(prng_));
+            if (pop.get_status(i) == Population::Evaluated)
+                whole->set_evaluation(index, pop.get_evaluation(i));
+        }
+    }
+    gdata.population_ = std::move(whole);
+}
+
+auto GeneticAlgorithm::generation(Population &pop, Island &island, Evaluation &eval, Island *neighbor, bool parallel) -> Outcome
+{
+    volatile bool *quit = &quit_;
+    Xoshiro256 &prng = island.prng_;
+    const unsigned pop_size = (unsigned)pop.capacity();
+
+    if (island.revision_ != eval.revision()) {
+        pop.clear_evaluation();
+        island.revision_ = eval.revision();
+    }
+    if (island.eval_bound_revision_ != eval.revision())
+        island.eval_bound_ = 0;
+
+    /* Evaluation */
+    {
+        // individuals go by batches, as many as there are channels on a chip
+        static constexpr unsigned batch_size = Evaluation::max_batch;
+        std::vector<unsigned> &pending = island.pending_;
+        pending.resize(pop_size);
+        unsigned num_pending = 0;
         for (unsigned i = 0; i < pop_size; ++i) {
-            ai::Individual ind = *pop.get_member(i);
+            if (pop.get_status(i) != Population::Evaluated)
+                pending[num_pending++] = i;
+        }
 
-            for (const MetaParameter &mp : MP_instrument) {
-                if (mp.flags & MP_NotAIFeature)
-                    continue;
+        double eval_bound = island.eval_bound_;
+        auto evaluate = [&](size_t b) {
+            if (*quit)
+                return;
+            const unsigned *indices = &pending[b * batch_size];
+            unsigned count = std::min<unsigned>(batch_size, num_pending - b * batch_size);
+            FmBank::Instrument batch[batch_size];
+            const FmBank::Instrument *ins[batch_size];
+            double results[batch_size];
+            bool complete[batch_size];
+            for (unsigned j = 0; j < count; ++j) {
+                pop.get_member(indices[j])->to_instrument(batch[j]);
+                ins[j] = &batch[j];
+            }
+            eval.evaluate_batch(ins, count, results, eval_bound, complete);
+            // the members cut short are known to be worse than the last
+            // survivors, they must not be selected on their partial result
+            for (unsigned j = 0; j < count; ++j)
+                pop.set_evaluation(indices[j], results[j], complete[j]);
+        };
+
+        unsigned num_batches = (num_pending + batch_size - 1) / batch_size;
+        if (parallel)
+            pool_->parallel_for(num_batches, task_granularity_, evaluate);
+        else {
+            for (unsigned b = 0; b < num_batches; ++b)
+                evaluate(b);
+        }
+    }
 
-                unsigned random = std::uniform_int_distribution<unsigned>(0, 99)(prng);
-                if (random != 0)
-                    continue;
+    if (*quit)
+        return Quit;
+
+    /* Immigration */
+    if (neighbor) {
+        std::vector<Migrant> &migrants = island.migrants_;
+        migrants.clear();
+        island.mailbox_.receive([&](Migrant &&migrant) {
+            if (migrant.revision_ == eval.revision())
+                migrants.push_back(std::move(migrant));
+        });
+
+        // the newest migrants take the places of the least evaluated
+        unsigned count = (unsigned)std::min<size_t>(migrants.size(), pop_size / 2);
+        if (count > 0) {
+            std::vector<unsigned> &order = island.order_;
+            order.resize(pop_size);
+            for (unsigned i = 0; i < pop_size; ++i)
+                order[i] = i;
+            std::partial_sort(
+                order.begin(), order.begin() + count, order.end(),
+                [&pop](unsigned a, unsigned b) { return pop.get_evaluation(a) < pop.get_evaluation(b); });
+            for (unsigned j = 0; j < count; ++j) {
+                const Migrant &migrant = migrants[migrants.size() - 1 - j];
+                pop.replace_member(order[j], migrant.ind_);
+                pop.set_evaluation(order[j], migrant.evaluation_);
+            }
+        }
+    }
 
-                mp.set(ind.ins_, std::uniform_int_distribution<unsigned>(mp.min, mp.max)(prng));
+    /* Fitness */
+    FitnessRecord &fitness_record = island.fitness_;
+    fitness_record.data.resize(pop_size);
+    double *fitness = fitness_record.data.data();
+    size_t fittest_index = pop.compute_fitness(fitness);
+    island.fittest_ = *pop.get_member(fittest_index);
+    island.fittest_evaluation_ = pop.get_evaluation(fittest_index);
+
+    /* Emigration */
+    if (neighbor && (island.generation_num_ + 1) % migration_interval_ == 0) {
+        unsigned count = std::min<unsigned>(Island::num_emigrants, pop_size);
+        std::vector<unsigned> &order = island.order_;
+        order.resize(pop_size);
+        for (unsigned i = 0; i < pop_size; ++i)
+            order[i] = i;
+        std::partial_sort(
+            order.begin(), order.begin() + count, order.end(),
+            [&pop](unsigned a, unsigned b) { return pop.get_evaluation(a) > pop.get_evaluation(b); });
+        for (unsigned j = 0; j < count; ++j) {
+            Migrant migrant;
+            migrant.ind_ = *pop.get_member(order[j]);
+            migrant.evaluation_ = pop.get_evaluation(order[j]);
+            migrant.revision_ = eval.revision();
+            neighbor->mailbox_.post(std::move(migrant));
+        }
+    }
+
+    if (*quit)
+        return Quit;
+
+    /* Selection */
+    {
+        Population next = Population::create_empty(pop_size);
+        {
+            for (unsigned i = 0; i < pop_size; ++i) {
+                double f = fitness[i];
+                if (f >= 1.0) {
+                    next.replace_member(i, *pop.get_member(i));
+                    next.set_evaluation(i, pop.get_evaluation(i));
+                }
+            }
+            for (unsigned i = 0; i < pop_size; ++i) {
+                for (double f = fitness[i]; f > 1.0 && !next.full(); f -= 1.0) {
+                    if (prng.uniform() < f) {
+                        size_t index = next.add_member(*pop.get_member(i));
+                        next.set_evaluation(index, pop.get_evaluation(i));
+                    }
+                }
+            }
+            if (next.empty()) {
+                /* Kill */
+                pop = Population::create_random(pop_size, prng);
+                island.eval_bound_ = 0;
+                return Restarted;
             }
 
-            pop.replace_member(i, ind);
+            double eval_bound = HUGE_VAL;
+            for (unsigned i = 0; i < pop_size; ++i) {
+                if (next.get_status(i) == Population::Evaluated)
+                    eval_bound = std::min(eval_bound, next.get_evaluation(i));
+            }
+            island.eval_bound_ = eval_bound;
+            island.eval_bound_revision_ = eval.revision();
         }
+        pop = std::move(next);
+    }
 
-        if (*quit)
-            return;
+    if (*quit)
+        return Quit;
 
-        if (gen_callback_)
-            gen_callback_(generation_num, fittest_ind);
+    /* Recombination */
+    if (!pop.full()) {
+        size_t num_selected = 0;
+        std::vector<const Individual *> &selected = island.selected_;
+        selected.resize(pop_size);
+
+        for (size_t i = 0; i < pop_size; ++i) {
+            if (const Individual *member = pop.get_member(i))
+                selected[num_selected++] = member;
+        }
 
-        gdata.generation_num_ = generation_num + 1;
+        for (size_t i = 0; i < pop_size; ++i) {
+            if (pop.get_member(i))
+                continue;
+
+            const ai::Individual &i1 = *selected[prng.below((uint32_t)num_selected)];
+            const ai::Individual &i2 = *selected[prng.below((uint32_t)num_selected)];
+            pop.replace_member(i, recombine(i1, i2, prng));
+        }
     }
+
+    if (*quit)
+        return Quit;
+
+    /* Mutation */
+    for (unsigned i = 0; i < pop_size; ++i) {
+        // unchanged members keep their evaluation
+        ai::Individual ind = *pop.get_member(i);
+        if (mutate(ind, prng))
+            pop.replace_member(i, ind);
+    }
+
+    if (*quit)
+        return Quit;
+
+    return Evolved;
 }
 
 } // namespace ai
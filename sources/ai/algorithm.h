@@ -1,6 +1,11 @@
 #pragma once
 #include "algorithm_data.h"
+#include "thread_pool.h"
+#include "random.h"
+#include "mailbox.h"
 #include <thread>
+#include <atomic>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
@@ -10,6 +15,7 @@ namespace ai {
 
 struct GeneticData;
 struct FitnessRecord;
+struct Snapshot;
 struct Population;
 struct Individual;
 class Evaluation;
@@ -24,29 +30,114 @@ public:
     typedef std::function<void(size_t, const Individual &)> GenCallback;
     typedef std::function<void(size_t, const FitnessRecord &)> FitCallback;
 
+    // the callbacks run on a thread of the algorithm, one at a time, with
+    // the data locked; they are set before the algorithm starts
     void set_generation_callback(GenCallback callback);
     void set_fitness_callback(FitCallback callback);
 
+    // the latest published results, or null before the first generation;
+    // this never waits for the algorithm
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // a change of the data, which is made between two generations, even
+    // while paused, or at once if the algorithm is not running; commands
+    // are applied in the order they are posted
+    typedef std::function<void(GeneticData &)> Command;
+    void post(Command command);
+
+    // exclusive access to the data, which waits for the generation in
+    // progress; prefer `post` on threads which must not wait
     GeneticData &lock(std::unique_lock<std::mutex> &lock);
+
     void start();
     void stop();
     bool set_paused(bool p);
     void toggle_paused();
+    // replaces the population with random members, as a command
     void reinitialize();
 
+    // resizes the population as a command, keeping the members which still
+    // fit; the size in effect changes when it is applied
+    void set_population_size(size_t size);
+    size_t population_size() const noexcept { return population_size_; }
+
+    // evaluation threads, 0 for as many as hardware threads
+    void set_num_threads(unsigned num_threads);
+    // how many batches make a task of the evaluation pool
+    void set_task_granularity(unsigned num_batches);
+
+    // with 2 islands or more, the population is split among as many threads
+    // which evolve on their own, and send elites to each other periodically;
+    // this takes effect on the next start
+    void set_num_islands(unsigned num_islands);
+    void set_migration_interval(unsigned num_generations);
+
+    // the random generator is seeded from the system by default; with the
+    // same seed, a population initialized afterwards evolves the same way,
+    // except in the steady state, where it depends on the timing of threads
+    void set_seed(uint64_t seed);
+
+    // in the steady state, workers keep breeding, evaluating and inserting
+    // children into the population without waiting for each other; this
+    // takes precedence over islands, and takes effect on the next start
+    void set_steady_state(bool steady);
+
 private:
+    struct Island;
+    struct SteadyState;
+    enum Outcome { Quit, Restarted, Evolved };
+
     void exec();
+    void exec_islands(unsigned num_islands);
+    void run_island(unsigned index);
+    void exec_steady();
+    void run_steady_worker(Xoshiro256 prng);
+    void serve_commands();
+    void apply_commands(GeneticData &gdata);
+    void reinitialize_population(GeneticData &gdata);
+    void resize_population(GeneticData &gdata, size_t size);
+    void publish(size_t generation_num, const Individual &fittest, double fittest_evaluation, const FitnessRecord &fitness);
+    void split_islands();
+    void merge_islands();
+    Outcome generation(Population &pop, Island &island, Evaluation &eval, Island *neighbor, bool parallel);
 
 private:
     std::unique_ptr<GeneticData> gdata_;
     std::mutex gmutex_;
     std::thread thread_;
+    std::unique_ptr<ThreadPool> pool_;
+    // for the population, and the source of the streams of the threads
+    Xoshiro256 prng_;
+    unsigned task_granularity_ = 1;
     GenCallback gen_callback_;
     FitCallback fit_callback_;
     bool quit_ = false;
     bool pause_ = false;
     std::condition_variable pause_cond_;
     std::mutex pause_mutex_;
+
+    // commands wait here for the next pause between generations, and
+    // results are published for the readers who do not want to wait
+    Mailbox<Command> commands_;
+    std::shared_ptr<const Snapshot> snapshot_;
+    std::atomic<size_t> population_size_{GeneticData::default_population_size};
+
+    // islands evolve as readers of the data, while lock() is for writers
+    unsigned num_islands_ = 0;
+    std::atomic<unsigned> migration_interval_{10};
+    std::vector<std::unique_ptr<Island>> islands_;
+    unsigned num_readers_ = 0;
+    unsigned num_writers_ = 0;
+    std::condition_variable island_cond_;
+    Individual best_;
+    double best_evaluation_ = 0;
+    unsigned best_revision_ = 0;
+
+    // steady-state engine, whose workers are readers in the same way
+    bool steady_state_ = false;
+    std::unique_ptr<SteadyState> steady_;
+    // changes with every replacement of the population
+    unsigned population_serial_ = 0;
 };
 
 } // namespace ai
@@ -1,5 +1,6 @@
 #pragma once
 #include "ai.h"
+#include <vector>
 
 namespace ai {
 
@@ -7,8 +8,13 @@ class Evaluation;
 
 struct GeneticData
 {
-    static constexpr size_t population_size = 100;
+    enum : size_t {
+        default_population_size = 100,
+        min_population_size = 2,
+        max_population_size = 65536,
+    };
 
+    size_t population_size_ = default_population_size;
     std::unique_ptr<ai::Evaluation> eval_;
     std::unique_ptr<ai::Population> population_;
     size_t generation_num_ = 0;
@@ -17,7 +23,17 @@ struct GeneticData
 //
 struct FitnessRecord
 {
-    double data[GeneticData::population_size];
+    std::vector<double> data;
+};
+
+// results of a generation, as the algorithm publishes them; a snapshot
+// never changes, and is shared with the readers
+struct Snapshot
+{
+    size_t generation_num_ = 0;
+    Individual fittest_;
+    double fittest_evaluation_ = 0;
+    FitnessRecord fitness_;
 };
 
 } // namespace ai
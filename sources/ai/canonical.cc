@@ -0,0 +1,141 @@
+#include "canonical.h"
+#include "ai.h"
+#include <cstring>
+#include <cmath>
+
+namespace ai {
+
+// the operators which each operator modulates, by algorithm, and those
+// which go to the output; operators are numbered from 0 here
+static const uint8_t operator_targets[8][4] = {
+    {1 << 1, 1 << 2, 1 << 3, 0},
+    {1 << 2, 1 << 2, 1 << 3, 0},
+    {1 << 3, 1 << 2, 1 << 3, 0},
+    {1 << 1, 1 << 3, 1 << 3, 0},
+    {1 << 1, 0, 1 << 3, 0},
+    {(1 << 1)|(1 << 2)|(1 << 3), 0, 0, 0},
+    {1 << 1, 0, 0, 0},
+    {0, 0, 0, 0},
+};
+
+static const uint8_t carrier_operators[8] = {
+    1 << 3, 1 << 3, 1 << 3, 1 << 3,
+    (1 << 1)|(1 << 3),
+    (1 << 1)|(1 << 2)|(1 << 3),
+    (1 << 1)|(1 << 2)|(1 << 3),
+    0xf,
+};
+
+// operator numbers in the order of the registers
+static const unsigned operator_index[4] = {
+    OPERATOR1_HR, OPERATOR2_HR, OPERATOR3_HR, OPERATOR4_HR,
+};
+
+static bool is_silent(unsigned attack, unsigned ssg_eg)
+{
+    // with a null rate, the attack never starts, except under SSG-EG
+    // where the envelope may be inverted
+    return attack == 0 && !(ssg_eg & 8);
+}
+
+static unsigned live_operators(unsigned alg, unsigned silent)
+{
+    unsigned live = 0;
+
+    // modulation only goes from lower to higher operator numbers
+    for (unsigned n = 4; n-- > 0;) {
+        if (silent & (1 << n))
+            continue;
+        if ((carrier_operators[alg] & (1 << n)) || (operator_targets[alg][n] & live))
+            live |= 1 << n;
+    }
+
+    return live;
+}
+
+unsigned live_operators(const FmBank::Instrument &ins)
+{
+    unsigned silent = 0;
+    for (unsigned n = 0; n < 4; ++n) {
+        const FmBank::Operator &op = ins.OP[operator_index[n]];
+        silent |= (unsigned)is_silent(op.attack, op.ssg_eg) << n;
+    }
+    return live_operators(ins.algorithm & 7, silent);
+}
+
+unsigned live_operators(const Individual &ind)
+{
+    unsigned silent = 0;
+    for (unsigned n = 0; n < 4; ++n) {
+        unsigned attack = ind.genes_[operator_gene(n, op_ar)];
+        unsigned ssg_eg = ind.genes_[operator_gene(n, op_ssg)];
+        silent |= (unsigned)is_silent(attack, ssg_eg) << n;
+    }
+    return live_operators(ind.genes_[gene_alg] & 7, silent);
+}
+
+void canonicalize(FmBank::Instrument &ins)
+{
+    unsigned live = live_operators(ins);
+
+    for (unsigned n = 0; n < 4; ++n) {
+        FmBank::Operator &op = ins.OP[operator_index[n]];
+        if (!(live & (1 << n))) {
+            std::memset(&op, 0, sizeof(op));
+            continue;
+        }
+        // a detune of 4 is a negative zero
+        if (op.detune == 4)
+            op.detune = 0;
+        // the SSG-EG mode is ignored unless enabled
+        if (!(op.ssg_eg & 8))
+            op.ssg_eg = 0;
+    }
+
+    // feedback goes to the first operator
+    if (!(live & 1))
+        ins.feedback = 0;
+
+    if (live == 0) {
+        ins.algorithm = 0;
+        ins.am = 0;
+        ins.fm = 0;
+    }
+}
+
+bool is_inaudible(const FmBank::Instrument &ins)
+{
+    unsigned carriers = live_operators(ins) & carrier_operators[ins.algorithm & 7];
+
+    // the envelope peaks at 0 dB, under the total level of 0.75 dB steps;
+    // modulation changes the phase of a carrier, but not its amplitude
+    double amplitude = 0;
+    for (unsigned n = 0; n < 4; ++n) {
+        if (carriers & (1 << n)) {
+            const FmBank::Operator &op = ins.OP[operator_index[n]];
+            amplitude += std::pow(10.0, -0.75 * (op.level & 127) / 20.0);
+        }
+    }
+
+    return amplitude < 1.0 / 32768;
+}
+
+uint64_t dead_genes(unsigned live)
+{
+    uint64_t dead = 0;
+
+    for (unsigned n = 0; n < 4; ++n) {
+        if (live & (1 << n))
+            continue;
+        // the genes which can revive the operator, as in is_silent
+        uint64_t revival = ((uint64_t)1 << op_ar) | ((uint64_t)1 << op_ssg);
+        uint64_t op_genes = (((uint64_t)1 << genes_per_operator) - 1) & ~revival;
+        dead |= op_genes << operator_gene(n, op_ar);
+    }
+    if (!(live & 1))
+        dead |= (uint64_t)1 << gene_fb;
+
+    return dead;
+}
+
+} // namespace ai
@@ -0,0 +1,31 @@
+#pragma once
+#include "instrument/bank.h"
+#include <cstdint>
+
+namespace ai {
+
+struct Individual;
+
+// put the instrument in a normal form, where the parameters which cannot
+// affect the sound are zero; instruments which sound the same on the
+// evaluation chip end up equal. Some emulators let an operator out of a
+// null attack, so this is not applied to the instruments themselves.
+void canonicalize(FmBank::Instrument &ins);
+
+// the operators whose output reaches the chip output, as a bit for each
+// operator number; an operator which never leaves the attack phase is
+// silent, and so is one which only modulates silent operators
+unsigned live_operators(const FmBank::Instrument &ins);
+unsigned live_operators(const Individual &ind);
+
+// whether no sound, or too little to count, can come out of the instrument:
+// no operator is live, or the carriers together cannot reach one step of a
+// 16-bit output, even at the top of the attack
+bool is_inaudible(const FmBank::Instrument &ins);
+
+// the genes which, given the live operators, cannot affect the sound, as a
+// bit for each gene; the attack rates and SSG-EG are not, since they may
+// bring an operator back to life
+uint64_t dead_genes(unsigned live);
+
+} // namespace ai
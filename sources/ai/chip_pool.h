@@ -0,0 +1,93 @@
+#pragma once
+#include "chips/opn_chip_base.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace ai {
+
+// keeps chips initialized for reuse, so that playing a note does not pay
+// for the emulator construction every time; chips are reset when they
+// are given back. It is not thread-safe, and is meant to be per thread.
+template <class Chip>
+class ChipPool
+{
+public:
+    class Handle;
+
+    Handle acquire(OPNFamily family, uint32_t rate);
+    void clear() { free_.clear(); }
+
+private:
+    struct Entry {
+        std::unique_ptr<Chip> chip;
+        OPNFamily family;
+        uint32_t rate;
+    };
+
+    void release(Entry &ent);
+
+private:
+    std::vector<Entry> free_;
+};
+
+//
+template <class Chip>
+class ChipPool<Chip>::Handle
+{
+public:
+    Handle() {}
+    Handle(ChipPool *pool, Entry ent) : pool_(pool), ent_(std::move(ent)) {}
+    Handle(Handle &&other) noexcept = default;
+    Handle &operator=(Handle &&other) noexcept;
+    ~Handle() { if (pool_ && ent_.chip) pool_->release(ent_); }
+
+    Chip &operator*() const noexcept { return *ent_.chip; }
+    Chip *operator->() const noexcept { return ent_.chip.get(); }
+    Chip *get() const noexcept { return ent_.chip.get(); }
+
+private:
+    ChipPool *pool_ = nullptr;
+    Entry ent_;
+};
+
+template <class Chip>
+auto ChipPool<Chip>::Handle::operator=(Handle &&other) noexcept -> Handle &
+{
+    if (this != &other) {
+        if (pool_ && ent_.chip)
+            pool_->release(ent_);
+        pool_ = other.pool_;
+        ent_ = std::move(other.ent_);
+    }
+    return *this;
+}
+
+template <class Chip>
+auto ChipPool<Chip>::acquire(OPNFamily family, uint32_t rate) -> Handle
+{
+    for (size_t i = free_.size(); i-- > 0;) {
+        Entry &ent = free_[i];
+        if (ent.family == family && ent.rate == rate) {
+            Handle h(this, std::move(ent));
+            free_.erase(free_.begin() + i);
+            return h;
+        }
+    }
+
+    Entry ent;
+    ent.chip.reset(new Chip(family));
+    ent.chip->setRate(rate, opn2_getNativeClockRate(family));
+    ent.family = family;
+    ent.rate = rate;
+    return Handle(this, std::move(ent));
+}
+
+template <class Chip>
+void ChipPool<Chip>::release(Entry &ent)
+{
+    ent.chip->reset();
+    free_.push_back(std::move(ent));
+}
+
+} // namespace ai
@@ -1,10 +1,15 @@
 #include "evaluation.h"
+#include "chip_pool.h"
+#include "canonical.h"
 #include "synth/tinysynth.h"
 #include "chips/mame_opn2.h"
 #include "chips/nuked_opn2.h"
 #include "chips/np2_opna.h"
+#include "chips/lanes_opna.h"
 #include "utility/music.h"
 #include <algorithm>
+#include <type_traits>
+#include <stdexcept>
 #include <cstring>
 #include <cmath>
 #include <cassert>
@@ -19,6 +24,63 @@ static constexpr double hop_duration = 10e-3;
 typedef NP2OPNA<> DefaultOPN;
 // typedef MameOPN2 DefaultOPN;
 // typedef NukedOPN2 DefaultOPN;
+// the same output as NP2OPNA, faster when built for AVX2
+// typedef LanesOPNA DefaultOPN;
+
+// the chips which can apply the setup of the patches at once, instead of
+// delaying the notes by the write buffer of real-time play
+static inline void set_direct_writes(OPNChipBase &, bool) {}
+static inline void set_direct_writes(NukedOPN2 &chip, bool direct) { chip.setDirectWrites(direct); }
+
+// notes played on the channels of a chip of their own, one instrument
+// per channel, rendered progressively
+class BatchRenderer
+{
+public:
+    BatchRenderer(const FmBank::Instrument *const ins[], unsigned count, double sample_rate, unsigned note);
+    // a null output skips the sound
+    void render(smpl_t *const output[], unsigned num_frames);
+
+private:
+    ChipPool<DefaultOPN>::Handle chip_;
+    unsigned count_ = 0;
+    TinySynth synth_[Evaluation::max_batch];
+};
+
+// sum of squared differences of two sets of coefficient rows
+static double squared_distance(const smpl_t *ref, const smpl_t *test, size_t num_steps)
+{
+    // one accumulator per coefficient, so the inner loop vectorizes
+    // without having to reorder floating point additions
+    double acc[num_coeffs] = {};
+    for (size_t i = 0; i < num_steps; ++i) {
+        const smpl_t *ref_step = &ref[i * num_coeffs];
+        const smpl_t *test_step = &test[i * num_coeffs];
+        for (size_t j = 0; j < num_coeffs; ++j) {
+            double dif = test_step[j] - ref_step[j];
+            acc[j] += dif * dif;
+        }
+    }
+
+    double total = 0;
+    for (size_t j = 0; j < num_coeffs; ++j)
+        total += acc[j];
+    return total;
+}
+
+// the result for an average error of the coefficients
+static double result_for_error(double err)
+{
+    double eval;
+    double best = 1.0; // XXX check this
+    if (err > 0) {
+        eval = 1.0 / err;
+        eval = std::min(best, eval);
+    }
+    else
+        eval = best;
+    return eval;
+}
 
 Evaluation::Evaluation()
     : reference_(new_fvec(1))
@@ -31,6 +93,7 @@ void Evaluation::set_reference(fvec_u sound)
 {
     reference_ = std::move(sound);
     update_reference_data();
+    ++revision_;
 }
 
 void Evaluation::set_sample_rate(double sample_rate)
@@ -40,52 +103,149 @@ void Evaluation::set_sample_rate(double sample_rate)
 
     sample_rate_ = sample_rate;
     update_reference_data();
+    ++revision_;
 }
 
 void Evaluation::set_reference_note(unsigned reference_note)
 {
+    if (reference_note_ == reference_note)
+        return;
+
     reference_note_ = reference_note;
+    ++revision_;
+}
+
+double Evaluation::evaluate(const FmBank::Instrument &ins, double bound, bool *complete) const
+{
+    const FmBank::Instrument *batch[1] = {&ins};
+    double result;
+    evaluate_batch(batch, 1, &result, bound, complete);
+    return result;
+}
+
+void Evaluation::evaluate_batch(const FmBank::Instrument *const ins[], unsigned count, double *results, double bound, bool *complete) const
+{
+    assert(count <= max_batch);
+
+    // clones and unchanged members are found in the cache, the others
+    // are rendered and analyzed
+    PatchKey keys[max_batch];
+    const FmBank::Instrument *missed[max_batch];
+    unsigned missed_index[max_batch];
+    unsigned num_missed = 0;
+    // equivalent instruments of the batch are rendered once
+    unsigned same_as[max_batch];
+    for (unsigned i = 0; i < count; ++i) {
+        same_as[i] = i;
+        if (is_inaudible(*ins[i])) {
+            results[i] = silence_result_;
+            if (complete)
+                complete[i] = true;
+            num_rejected_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        keys[i] = PatchKey::from_instrument(*ins[i]);
+        for (unsigned j = 0; j < num_missed && same_as[i] == i; ++j) {
+            if (keys[missed_index[j]] == keys[i])
+                same_as[i] = missed_index[j];
+        }
+        if (same_as[i] != i)
+            continue;
+        if (cache_.find(keys[i], revision_, &results[i])) {
+            if (complete)
+                complete[i] = true;
+        }
+        else {
+            missed[num_missed] = ins[i];
+            missed_index[num_missed++] = i;
+        }
+    }
+
+    if (num_missed > 0) {
+        double missed_results[max_batch];
+        bool missed_complete[max_batch];
+        evaluate_uncached(missed, num_missed, missed_results, bound, missed_complete);
+
+        for (unsigned j = 0; j < num_missed; ++j) {
+            unsigned i = missed_index[j];
+            results[i] = missed_results[j];
+            if (complete)
+                complete[i] = missed_complete[j];
+            if (missed_complete[j])
+                cache_.insert(keys[i], revision_, missed_results[j]);
+        }
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (same_as[i] != i) {
+            results[i] = results[same_as[i]];
+            if (complete)
+                complete[i] = complete[same_as[i]];
+        }
+    }
 }
 
-double Evaluation::evaluate(const FmBank::Instrument &ins) const
+void Evaluation::evaluate_uncached(const FmBank::Instrument *const ins[], unsigned count, double *results, double bound, bool *complete) const
 {
     const fvec_t *ref = reference_.get();
     unsigned num_frames = ref->length;
     double sample_rate = sample_rate_;
-    fvec_u test = generate(ins, num_frames, sample_rate, reference_note_);
 
-    const std::vector<fvec_u> &ref_coeff = reference_data_;
-    std::vector<fvec_u> test_coeff = compute_mfcc_coeffs(test.get(), sample_rate);
+    const FeatureMatrix &ref_coeff = reference_data_;
+    unsigned num_steps = ref_coeff.rows();
 
-    size_t num_steps = test_coeff.size();
-    assert(num_steps == ref_coeff.size());
+    // the result is better than `bound` only if the sum of errors stays
+    // below this limit; the sum only ever grows as steps are added.
+    double err_limit = (bound > 0) ? (num_steps / bound) : HUGE_VAL;
 
-    double total_err = 0;
-    for (size_t i = 0; i < num_steps; ++i) {
-        const smpl_t *ref_step = ref_coeff[i]->data;
-        const smpl_t *test_step = test_coeff[i]->data;
+    MfccAnalyzer *analyzers[max_batch];
+    for (unsigned i = 0; i < count; ++i)
+        analyzers[i] = &MfccAnalyzer::for_thread(sample_rate, i);
 
-        double err = 0;
-        for (size_t j = 0; j < num_coeffs; ++j) {
-            double dif = test_step[j] - ref_step[j];
-            err += dif * dif;
-        }
+    unsigned hop_length = analyzers[0]->hop_length();
+    assert(num_steps == (num_frames + hop_length - 1) / hop_length);
 
-        total_err += err;
-    }
+    BatchRenderer renderer(ins, count, sample_rate, reference_note_);
 
-    total_err /= num_steps; // average, not sure this is as intended
+    thread_local FeatureMatrix test_hops;
+    test_hops.resize(count, hop_length);
 
-    double eval;
-    double best = 1.0; // XXX check this
-    if (total_err > 0) {
-        eval = 1.0 / total_err;
-        eval = std::min(best, eval);
+    smpl_t test_step[num_coeffs];
+    fvec_t test_coeffs;
+    test_coeffs.length = num_coeffs;
+    test_coeffs.data = test_step;
+
+    double total_err[max_batch] = {};
+    bool aborted[max_batch] = {};
+    unsigned num_running = count;
+
+    for (unsigned step = 0; step < num_steps && num_running > 0; ++step) {
+        unsigned frames = std::min(hop_length, num_frames - step * hop_length);
+
+        smpl_t *test_hop[max_batch];
+        for (unsigned i = 0; i < count; ++i)
+            test_hop[i] = aborted[i] ? nullptr : test_hops.row(i);
+        renderer.render(test_hop, frames);
+
+        for (unsigned i = 0; i < count; ++i) {
+            if (aborted[i])
+                continue;
+            analyzers[i]->process(test_hop[i], frames, &test_coeffs);
+            total_err[i] += squared_distance(ref_coeff.row(step), test_step, 1);
+            if (total_err[i] > err_limit) {
+                aborted[i] = true;
+                --num_running;
+            }
+        }
     }
-    else
-        eval = best;
 
-    return eval;
+    for (unsigned i = 0; i < count; ++i) {
+        if (complete)
+            complete[i] = !aborted[i];
+
+        double err = total_err[i] / num_steps; // average, not sure this is as intended
+        results[i] = result_for_error(err);
+    }
 }
 
 void Evaluation::update_reference_data()
@@ -93,93 +253,177 @@ void Evaluation::update_reference_data()
     fvec_t *ref = reference_.get();
 
     reference_data_ = compute_mfcc_coeffs(ref, sample_rate_);
+
+    // silence, as rendered for an instrument which makes no sound
+    fvec_u silence(new_fvec(ref->length));
+    if (!silence)
+        throw std::bad_alloc();
+    FeatureMatrix silence_data = compute_mfcc_coeffs(silence.get(), sample_rate_);
+
+    // summed by steps, in the same order as an evaluation
+    unsigned num_steps = reference_data_.rows();
+    double total_err = 0;
+    for (unsigned step = 0; step < num_steps; ++step)
+        total_err += squared_distance(reference_data_.row(step), silence_data.row(step), 1);
+    silence_result_ = result_for_error(total_err / num_steps);
 }
 
-std::vector<fvec_u> Evaluation::compute_mfcc_coeffs(const fvec_t *in, double sample_rate)
+FeatureMatrix Evaluation::compute_mfcc_coeffs(const fvec_t *in, double sample_rate)
 {
-    unsigned window_length = std::lround(window_duration * sample_rate);
-    unsigned hop_length = std::lround(hop_duration * sample_rate);
+    FeatureMatrix result;
+    compute_mfcc_coeffs(in, sample_rate, result);
+    return result;
+}
+
+void Evaluation::compute_mfcc_coeffs(const fvec_t *in, double sample_rate, FeatureMatrix &result)
+{
+    MfccAnalyzer &analyzer = MfccAnalyzer::for_thread(sample_rate);
+    unsigned hop_length = analyzer.hop_length();
+
+    unsigned num_steps = (in->length + hop_length - 1) / hop_length;
+    result.resize(num_steps, num_coeffs);
+
+    for (unsigned step = 0; step < num_steps; ++step) {
+        unsigned ref_pos = step * hop_length;
+        fvec_t coeffs = result.row_vector(step);
+        analyzer.process(&in->data[ref_pos], in->length - ref_pos, &coeffs);
+    }
+}
 
-    std::vector<fvec_u> result;
-    result.reserve(1 + in->length / hop_length);
+//
+MfccAnalyzer::MfccAnalyzer(double sample_rate)
+    : sample_rate_(sample_rate),
+      window_length_(std::lround(window_duration * sample_rate)),
+      hop_length_(std::lround(hop_duration * sample_rate))
+{
+    unsigned window_length = window_length_;
+    unsigned hop_length = hop_length_;
 
-    aubio_mfcc_u mfcc(
-        new_aubio_mfcc(window_length, num_filters, num_coeffs, sample_rate));
-    if (!mfcc)
+    mfcc_.reset(new_aubio_mfcc(window_length, num_filters, num_coeffs, sample_rate));
+    if (!mfcc_)
         throw std::runtime_error("Cannot create the MFCC object.");
 
-    aubio_pvoc_u pv(new_aubio_pvoc(window_length, hop_length));
-    if (!pv)
+    pv_.reset(new_aubio_pvoc(window_length, hop_length));
+    if (!pv_)
         throw std::runtime_error("Cannot create the Phase Vocoder object.");
 
-    fvec_u frame(new_fvec(window_length));
-    if (!frame)
+    frame_.reset(new_fvec(window_length));
+    if (!frame_)
         throw std::bad_alloc();
 
-    cvec_u spec(new_cvec(window_length));
-    if (!spec)
+    spec_.reset(new_cvec(window_length));
+    if (!spec_)
         throw std::bad_alloc();
+}
+
+MfccAnalyzer &MfccAnalyzer::for_thread(double sample_rate, unsigned index)
+{
+    thread_local std::unique_ptr<MfccAnalyzer> analyzers[Evaluation::max_batch];
+    std::unique_ptr<MfccAnalyzer> &analyzer = analyzers[index];
+
+    if (!analyzer || analyzer->sample_rate_ != sample_rate)
+        analyzer.reset(new MfccAnalyzer(sample_rate));
+    else
+        analyzer->reset();
 
-    for (unsigned ref_pos = 0; ref_pos < in->length; ref_pos += hop_length) {
-        fvec_u coeffs(new_fvec(num_coeffs));
-        if (!coeffs)
-            throw std::bad_alloc();
+    return *analyzer;
+}
 
-        unsigned count = std::min(window_length, in->length - ref_pos);
-        std::copy(&in->data[ref_pos], &in->data[ref_pos + count], frame->data);
-        std::fill(&frame->data[count], &frame->data[window_length], 0);
+void MfccAnalyzer::reset()
+{
+    if (!dirty_)
+        return;
 
-        aubio_pvoc_do(pv.get(), frame.get(), spec.get());
-        aubio_mfcc_do(mfcc.get(), spec.get(), coeffs.get());
+    // the phase vocoder has no reset, but its only state is the last
+    // `window - hop` samples of input; flush them out with silence
+    fvec_t *frame = frame_.get();
+    std::fill(frame->data, frame->data + frame->length, 0);
+    for (unsigned n = 0; n < window_length_ - hop_length_; n += hop_length_)
+        aubio_pvoc_do(pv_.get(), frame, spec_.get());
 
-        result.push_back(std::move(coeffs));
-    }
+    dirty_ = false;
+}
 
-    return result;
+void MfccAnalyzer::process(const smpl_t *in, unsigned count, fvec_t *coeffs)
+{
+    unsigned window_length = window_length_;
+    fvec_t *frame = frame_.get();
+
+    count = std::min(window_length, count);
+    std::copy(in, in + count, frame->data);
+    std::fill(&frame->data[count], &frame->data[window_length], 0);
+
+    aubio_pvoc_do(pv_.get(), frame, spec_.get());
+    aubio_mfcc_do(mfcc_.get(), spec_.get(), coeffs);
+
+    dirty_ = true;
 }
 
 fvec_u Evaluation::generate(const FmBank::Instrument &ins, unsigned num_frames, double sample_rate, unsigned note)
 {
     fvec_u snd(new_fvec(num_frames));
-    TinySynth synth;
+    if (!snd)
+        throw std::bad_alloc();
+
+    const FmBank::Instrument *batch[1] = {&ins};
+    BatchRenderer renderer(batch, 1, sample_rate, note);
+    smpl_t *output[1] = {snd->data};
+    renderer.render(output, num_frames);
+
+    #pragma message("XXX Remove this")
+    if (0) {
+        save_sound_file("/tmp/foobar.wav", snd.get(), sample_rate);
+    }
 
-    std::memset(&synth, 0, sizeof(TinySynth));
+    return snd;
+}
 
-    OPNFamily family;
+//
+static OPNFamily family_for_sample_rate(double sample_rate)
+{
     switch ((unsigned)sample_rate) {
     case 53267:
-        family = OPNChip_OPN2; break;
+        return OPNChip_OPN2;
     case 55466:
-        family = OPNChip_OPNA; break;
+        return OPNChip_OPNA;
     default:
         throw std::runtime_error("Cannot find a chip model to match sample rate.");
     }
+}
 
-    DefaultOPN chip(family);
-    chip.setRate((unsigned)sample_rate, opn2_getNativeClockRate(family));
-    synth.m_chip = &chip;
-    synth.m_notenum = note;
-    synth.setInstrument(ins);
-    synth.noteOn();
-
-    std::unique_ptr<int16_t[]> temp(new int16_t[2 * num_frames]);
-    synth.generate(temp.get(), num_frames);
-
-    for (unsigned i = 0; i < num_frames; ++i)
-        snd->data[i] = temp[2 * i] / 32768.0;
-
-    #pragma message("XXX Remove this")
-    if (0) {
-        save_sound_file("/tmp/foobar.wav", snd.get(), sample_rate);
-    }
-    if (0) {
-        FILE *fh = fopen("/tmp/foobar.dat", "w");
-        for (unsigned i = 0; i < num_frames; ++i)
-            fprintf(fh, "%u %d %d\n", i , temp[2 * i], temp[2 * i + 1]);
-        fclose(fh);
+BatchRenderer::BatchRenderer(const FmBank::Instrument *const ins[], unsigned count, double sample_rate, unsigned note)
+    : count_(count)
+{
+    assert(count <= Evaluation::max_batch);
+
+    thread_local ChipPool<DefaultOPN> chip_pool;
+    chip_ = chip_pool.acquire(family_for_sample_rate(sample_rate), (unsigned)sample_rate);
+
+    DefaultOPN &chip = *chip_;
+    // the chip output is taken before the resampler
+    assert(chip.effectiveRate() == (unsigned)sample_rate);
+
+    set_direct_writes(chip, true);
+    for (unsigned i = 0; i < count; ++i) {
+        TinySynth &synth = synth_[i];
+        std::memset(&synth, 0, sizeof(TinySynth));
+        synth.m_chip = &chip;
+        synth.m_notenum = note;
+        synth.setInstrument(*ins[i], i);
+        synth.noteOn();
     }
+    set_direct_writes(chip, false);
+}
 
-    return snd;
+void BatchRenderer::render(smpl_t *const output[], unsigned num_frames)
+{
+    static_assert(std::is_same<smpl_t, float>::value,
+                  "the chip renders directly into single precision samples");
+
+    float *channels[6] = {};
+    for (unsigned i = 0; i < count_; ++i)
+        channels[i] = output[i];
+    chip_->generateChannelsFloat(channels, num_frames);
 }
 
 } // namespace ai
@@ -1,7 +1,10 @@
 #pragma once
+#include "features.h"
+#include "evaluation_cache.h"
 #include "instrument/bank.h"
 #include "utility/aubio++.h"
-#include <vector>
+#include <atomic>
+#include <cstdint>
 
 namespace ai {
 
@@ -14,23 +17,76 @@ public:
     void set_sample_rate(double sample_rate);
     void set_reference_note(unsigned reference_note);
 
-    double evaluate(const FmBank::Instrument &ins) const;
+    // render and analyze hop by hop, giving up as soon as the result is
+    // known to be worse than `bound` (if nonzero); an abandoned evaluation
+    // returns an upper limit of the true result, below `bound`.
+    double evaluate(const FmBank::Instrument &ins, double bound = 0, bool *complete = nullptr) const;
+
+    // evaluate several instruments together, on the channels of one chip;
+    // results and completion flags are given for each of them. Results of
+    // complete evaluations are cached until the settings change. Inaudible
+    // instruments are not rendered, they get the result of silence.
+    void evaluate_batch(const FmBank::Instrument *const ins[], unsigned count, double *results, double bound = 0, bool *complete = nullptr) const;
+
+    enum { max_batch = 6 };
 
     static fvec_u generate(const FmBank::Instrument &ins, unsigned num_frames, double sample_rate, unsigned note);
-    static std::vector<fvec_u> compute_mfcc_coeffs(const fvec_t *in, double sample_rate);
+    static FeatureMatrix compute_mfcc_coeffs(const fvec_t *in, double sample_rate);
+    static void compute_mfcc_coeffs(const fvec_t *in, double sample_rate, FeatureMatrix &result);
 
     const fvec_t &reference() const noexcept { return *reference_; }
     double sample_rate() const noexcept { return sample_rate_; }
     unsigned reference_note() const noexcept { return reference_note_; }
 
+    // changes every time the settings which determine the results change
+    unsigned revision() const noexcept { return revision_; }
+
+    const EvaluationCache &cache() const noexcept { return cache_; }
+    void set_cache_capacity(size_t capacity) { cache_.set_capacity(capacity); }
+
+    // number of instruments found inaudible, which were not rendered
+    uint64_t num_rejected() const noexcept { return num_rejected_.load(std::memory_order_relaxed); }
+
 private:
     void update_reference_data();
+    void evaluate_uncached(const FmBank::Instrument *const ins[], unsigned count, double *results, double bound, bool *complete) const;
 
 private:
     fvec_u reference_;
     double sample_rate_ = 44100;
     unsigned reference_note_ = 69;
-    std::vector<fvec_u> reference_data_;
+    unsigned revision_ = 0;
+    FeatureMatrix reference_data_;
+    double silence_result_ = 0;
+    mutable EvaluationCache cache_;
+    mutable std::atomic<uint64_t> num_rejected_{0};
+};
+
+//
+class MfccAnalyzer
+{
+public:
+    explicit MfccAnalyzer(double sample_rate);
+
+    // get one of the calling thread's analyzers, reset and ready for a
+    // new sound; there is one for each sound of an evaluation batch
+    static MfccAnalyzer &for_thread(double sample_rate, unsigned index = 0);
+
+    void reset();
+    void process(const smpl_t *in, unsigned count, fvec_t *coeffs);
+
+    unsigned window_length() const noexcept { return window_length_; }
+    unsigned hop_length() const noexcept { return hop_length_; }
+
+private:
+    double sample_rate_ = 0;
+    unsigned window_length_ = 0;
+    unsigned hop_length_ = 0;
+    bool dirty_ = false;
+    aubio_mfcc_u mfcc_;
+    aubio_pvoc_u pv_;
+    fvec_u frame_;
+    cvec_u spec_;
 };
 
 } // namespace ai
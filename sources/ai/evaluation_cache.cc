@@ -0,0 +1,151 @@
+#include "evaluation_cache.h"
+#include "canonical.h"
+#include "synth/tinysynth.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ai {
+
+PatchKey PatchKey::from_instrument(const FmBank::Instrument &ins)
+{
+    // equivalent instruments share the key
+    FmBank::Instrument canonical = ins;
+    canonicalize(canonical);
+
+    OPN_PatchSetup patch;
+    TinySynth::setupPatch(canonical, patch);
+
+    uint8_t bytes[sizeof(PatchKey::words)] = {};
+    static_assert(4 * sizeof(OPN_Operator) + 2 <= sizeof(bytes), "the key is too small");
+
+    size_t size = 0;
+    for (unsigned op = 0; op < 4; ++op) {
+        std::memcpy(&bytes[size], patch.OPS[op].data, sizeof(patch.OPS[op].data));
+        size += sizeof(patch.OPS[op].data);
+    }
+    bytes[size++] = patch.fbalg;
+    bytes[size++] = patch.lfosens;
+
+    PatchKey key;
+    std::memcpy(key.words, bytes, sizeof(bytes));
+    return key;
+}
+
+uint64_t PatchKey::hash() const noexcept
+{
+    uint64_t h = 0;
+    for (uint64_t word : words) {
+        h ^= word + 0x9e3779b97f4a7c15u + (h << 6) + (h >> 2);
+        h *= 0xff51afd7ed558ccdu;
+        h ^= h >> 33;
+    }
+    return h;
+}
+
+bool PatchKey::operator==(const PatchKey &other) const noexcept
+{
+    return words[0] == other.words[0] && words[1] == other.words[1] &&
+        words[2] == other.words[2] && words[3] == other.words[3];
+}
+
+//
+EvaluationCache::EvaluationCache(size_t capacity)
+{
+    set_capacity(capacity);
+}
+
+EvaluationCache::~EvaluationCache()
+{
+}
+
+void EvaluationCache::set_capacity(size_t capacity)
+{
+    size_t sets = (capacity + num_shards * ways - 1) / (num_shards * ways);
+
+    for (Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sets.reset(sets ? new Set[sets]() : nullptr);
+        shard.num_sets = sets;
+    }
+    sets_per_shard_.store(sets, std::memory_order_relaxed);
+}
+
+bool EvaluationCache::find(const PatchKey &key, unsigned revision, double *result)
+{
+    if (sets_per_shard_.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    uint64_t hash = key.hash();
+    Shard &shard = shard_for(hash);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.num_sets == 0)
+        return false;
+    Set &set = set_for(shard, hash);
+    for (const Entry &entry : set.entries) {
+        if (entry.valid && entry.revision == revision && entry.key == key) {
+            *result = entry.result;
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void EvaluationCache::insert(const PatchKey &key, unsigned revision, double result)
+{
+    if (sets_per_shard_.load(std::memory_order_relaxed) == 0)
+        return;
+
+    uint64_t hash = key.hash();
+    Shard &shard = shard_for(hash);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.num_sets == 0)
+        return;
+    Set &set = set_for(shard, hash);
+
+    // take the entry of the same key, or a stale one, or the oldest
+    Entry *target = nullptr;
+    for (Entry &entry : set.entries) {
+        if (entry.valid && entry.key == key) {
+            target = &entry;
+            break;
+        }
+        if (!target && (!entry.valid || entry.revision != revision))
+            target = &entry;
+    }
+    if (!target) {
+        target = &set.entries[set.next_victim];
+        set.next_victim = (set.next_victim + 1) % ways;
+    }
+
+    target->key = key;
+    target->result = result;
+    target->revision = revision;
+    target->valid = true;
+}
+
+void EvaluationCache::clear()
+{
+    for (Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::fill(shard.sets.get(), shard.sets.get() + shard.num_sets, Set());
+    }
+    hits_.store(0, std::memory_order_relaxed);
+    misses_.store(0, std::memory_order_relaxed);
+}
+
+auto EvaluationCache::shard_for(uint64_t hash) noexcept -> Shard &
+{
+    return shards_[hash % num_shards];
+}
+
+auto EvaluationCache::set_for(Shard &shard, uint64_t hash) const noexcept -> Set &
+{
+    return shard.sets[(hash / num_shards) % shard.num_sets];
+}
+
+} // namespace ai
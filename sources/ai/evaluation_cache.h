@@ -0,0 +1,83 @@
+#pragma once
+#include "instrument/bank.h"
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace ai {
+
+// register data of the canonical form of an instrument, as the synth
+// writes it to the chip; instruments which are equal in this form sound
+// the same
+struct PatchKey
+{
+    uint64_t words[4];
+
+    static PatchKey from_instrument(const FmBank::Instrument &ins);
+    uint64_t hash() const noexcept;
+
+    bool operator==(const PatchKey &other) const noexcept;
+    bool operator!=(const PatchKey &other) const noexcept { return !operator==(other); }
+};
+
+// results of complete evaluations, by patch, which are valid under a given
+// revision of the evaluation settings; the memory is bounded, and the
+// entries are split among independently locked shards.
+class EvaluationCache
+{
+public:
+    explicit EvaluationCache(size_t capacity = default_capacity);
+    ~EvaluationCache();
+
+    enum { default_capacity = 65536 };
+
+    // how many results are kept at most, rounded to fill the shards;
+    // with no capacity, nothing is kept
+    size_t capacity() const noexcept { return num_shards * sets_per_shard_.load(std::memory_order_relaxed) * ways; }
+    void set_capacity(size_t capacity);
+
+    bool find(const PatchKey &key, unsigned revision, double *result);
+    void insert(const PatchKey &key, unsigned revision, double result);
+    void clear();
+
+    uint64_t hits() const noexcept { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const noexcept { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    enum { num_shards = 16, ways = 4 };
+
+    struct Entry {
+        PatchKey key;
+        double result;
+        unsigned revision;
+        bool valid;
+    };
+
+    // entries of a key are looked up in a set of a few, where the least
+    // recently inserted makes room for a new entry
+    struct Set {
+        Entry entries[ways];
+        unsigned next_victim;
+    };
+
+    // the number of sets goes with the sets, under the mutex, so that a
+    // change of capacity is seen whole by a lookup
+    struct Shard {
+        std::mutex mutex;
+        std::unique_ptr<Set[]> sets;
+        size_t num_sets = 0;
+    };
+
+    Set &set_for(Shard &shard, uint64_t hash) const noexcept;
+    Shard &shard_for(uint64_t hash) noexcept;
+
+private:
+    Shard shards_[num_shards];
+    std::atomic<size_t> sets_per_shard_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+} // namespace ai
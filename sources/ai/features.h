@@ -0,0 +1,67 @@
+#pragma once
+#include "utility/aubio++.h"
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace ai {
+
+// row-major matrix of analysis coefficients, one row per analysis hop,
+// stored contiguously in a single aligned block
+class FeatureMatrix
+{
+public:
+    FeatureMatrix() {}
+    FeatureMatrix(unsigned rows, unsigned cols) { resize(rows, cols); }
+
+    // reallocates only if the current storage is too small
+    void resize(unsigned rows, unsigned cols);
+
+    unsigned rows() const noexcept { return rows_; }
+    unsigned cols() const noexcept { return cols_; }
+    size_t size() const noexcept { return (size_t)rows_ * cols_; }
+    bool empty() const noexcept { return size() == 0; }
+
+    smpl_t *data() noexcept { return data_; }
+    const smpl_t *data() const noexcept { return data_; }
+    smpl_t *row(unsigned i) noexcept { return &data_[(size_t)i * cols_]; }
+    const smpl_t *row(unsigned i) const noexcept { return &data_[(size_t)i * cols_]; }
+
+    // aubio vector aliasing a row, valid until the next resize
+    fvec_t row_vector(unsigned i) noexcept;
+
+    enum { alignment = 64 };
+
+private:
+    unsigned rows_ = 0;
+    unsigned cols_ = 0;
+    size_t capacity_ = 0;
+    std::unique_ptr<uint8_t[]> storage_;
+    smpl_t *data_ = nullptr;
+};
+
+inline void FeatureMatrix::resize(unsigned rows, unsigned cols)
+{
+    size_t size = (size_t)rows * cols;
+
+    if (size > capacity_) {
+        storage_.reset(new uint8_t[size * sizeof(smpl_t) + alignment]);
+        uintptr_t addr = reinterpret_cast<uintptr_t>(storage_.get());
+        addr = (addr + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        data_ = reinterpret_cast<smpl_t *>(addr);
+        capacity_ = size;
+    }
+
+    rows_ = rows;
+    cols_ = cols;
+}
+
+inline fvec_t FeatureMatrix::row_vector(unsigned i) noexcept
+{
+    fvec_t vec;
+    vec.length = cols_;
+    vec.data = row(i);
+    return vec;
+}
+
+} // namespace ai
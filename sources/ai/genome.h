@@ -0,0 +1,247 @@
+#pragma once
+#include "ai.h"
+#include "random.h"
+#include "instrument/metaparameter.h"
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+namespace ai {
+
+// a gene, with its range and flags known at compile time, and the field
+// of the instrument which it stands for
+template <class Access, unsigned Min, unsigned Max, unsigned Flags>
+struct GeneField
+{
+    enum : unsigned { min = Min, max = Max, flags = Flags };
+    static_assert(Min <= Max && Max <= 255, "the gene does not fit in a byte");
+
+    static unsigned get(const FmBank::Instrument &ins) { return Access::get(ins); }
+    static void set(FmBank::Instrument &ins, unsigned value) { Access::set(ins, value); }
+};
+
+template <uint8_t FmBank::Instrument::*Member>
+struct ChannelAccess
+{
+    static unsigned get(const FmBank::Instrument &ins) { return ins.*Member; }
+    static void set(FmBank::Instrument &ins, unsigned value) { ins.*Member = (uint8_t)value; }
+};
+
+template <class T, T FmBank::Operator::*Member, unsigned Op>
+struct OperatorAccess
+{
+    static unsigned get(const FmBank::Instrument &ins) { return ins.OP[Op].*Member; }
+    static void set(FmBank::Instrument &ins, unsigned value) { ins.OP[Op].*Member = (T)value; }
+};
+
+template <class... Fields>
+struct GeneList
+{
+    enum : unsigned { size = sizeof...(Fields) };
+};
+
+//
+#define AI_CHANNEL_GENE(member, min, max)                               \
+    GeneField<ChannelAccess<&FmBank::Instrument::member>, min, max, MP_None>
+#define AI_OPERATOR_GENE(type, member, op, min, max, flags)             \
+    GeneField<OperatorAccess<type, &FmBank::Operator::member, op>, min, max, flags>
+#define AI_OPERATOR_GENES(op, flags)                                    \
+    AI_OPERATOR_GENE(uint8_t, attack, op, 0, 31, flags),                \
+    AI_OPERATOR_GENE(uint8_t, decay1, op, 0, 31, flags),                \
+    AI_OPERATOR_GENE(uint8_t, decay2, op, 0, 31, flags),                \
+    AI_OPERATOR_GENE(uint8_t, sustain, op, 0, 15, flags),               \
+    AI_OPERATOR_GENE(uint8_t, release, op, 0, 15, flags),               \
+    AI_OPERATOR_GENE(uint8_t, level, op, 0, 127, flags),                \
+    AI_OPERATOR_GENE(uint8_t, ratescale, op, 0, 3, flags),              \
+    AI_OPERATOR_GENE(uint8_t, fmult, op, 0, 15, flags),                 \
+    AI_OPERATOR_GENE(uint8_t, detune, op, 0, 7, flags),                 \
+    AI_OPERATOR_GENE(bool, am_enable, op, 0, 1, flags),                 \
+    AI_OPERATOR_GENE(uint8_t, ssg_eg, op, 0, 15, (flags)|MP_Bits)
+
+// the genes of an instrument, in the order of `Gene` and `OperatorGene`,
+// which is the order of the AI features of `MP_instrument`
+typedef GeneList<
+    AI_CHANNEL_GENE(algorithm, 0, 7),
+    AI_CHANNEL_GENE(feedback, 0, 7),
+    AI_CHANNEL_GENE(am, 0, 3),
+    AI_CHANNEL_GENE(fm, 0, 7),
+    AI_OPERATOR_GENES(OPERATOR1_HR, MP_Operator1),
+    AI_OPERATOR_GENES(OPERATOR2_HR, MP_Operator2),
+    AI_OPERATOR_GENES(OPERATOR3_HR, MP_Operator3),
+    AI_OPERATOR_GENES(OPERATOR4_HR, MP_Operator4)
+> InstrumentGenes;
+
+#undef AI_CHANNEL_GENE
+#undef AI_OPERATOR_GENE
+#undef AI_OPERATOR_GENES
+
+//
+template <unsigned Index, class List> struct GeneAt;
+
+template <class Field, class... Rest>
+struct GeneAt<0, GeneList<Field, Rest...>>
+{
+    typedef Field type;
+};
+
+template <unsigned Index, class Field, class... Rest>
+struct GeneAt<Index, GeneList<Field, Rest...>>
+{
+    typedef typename GeneAt<Index - 1, GeneList<Rest...>>::type type;
+};
+
+static_assert(InstrumentGenes::size == (unsigned)num_genes, "the genes do not match the genome");
+static_assert(GeneAt<operator_gene(1, op_tl), InstrumentGenes>::type::max == 127, "the genes are out of order");
+static_assert(GeneAt<operator_gene(3, op_ssg), InstrumentGenes>::type::flags == (MP_Operator4|MP_Bits), "the genes are out of order");
+
+//
+inline unsigned clamp_gene(unsigned value, unsigned min, unsigned max)
+{
+    return (value < min) ? min : (value > max) ? max : value;
+}
+
+// ranges of the genes, to be found by index
+template <class List> struct GeneRanges;
+
+template <class... Fields>
+struct GeneRanges<GeneList<Fields...>>
+{
+    static constexpr uint8_t min[sizeof...(Fields)] = {Fields::min...};
+    static constexpr uint8_t max[sizeof...(Fields)] = {Fields::max...};
+};
+
+template <class... Fields>
+constexpr uint8_t GeneRanges<GeneList<Fields...>>::min[sizeof...(Fields)];
+template <class... Fields>
+constexpr uint8_t GeneRanges<GeneList<Fields...>>::max[sizeof...(Fields)];
+
+//
+inline unsigned count_bits(uint64_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return (unsigned)((x * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+// index of the lowest bit which is set, in a nonzero word
+inline unsigned lowest_bit(uint64_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(x);
+#else
+    return count_bits((x & (0 - x)) - 1);
+#endif
+}
+
+// operations on all the genes, unrolled at compile time
+template <class List, unsigned Index = 0> struct GeneOps;
+
+template <unsigned Index>
+struct GeneOps<GeneList<>, Index>
+{
+    static void randomize(uint8_t *, Xoshiro256 &) {}
+    static void clamp(uint8_t *) {}
+    static void from_instrument(uint8_t *, const FmBank::Instrument &) {}
+    static void to_instrument(const uint8_t *, FmBank::Instrument &) {}
+    static void recombine(uint8_t *, const uint8_t *, const uint8_t *, const uint16_t *) {}
+};
+
+template <class Field, class... Rest, unsigned Index>
+struct GeneOps<GeneList<Field, Rest...>, Index>
+{
+    typedef GeneOps<GeneList<Rest...>, Index + 1> Next;
+
+    static void randomize(uint8_t *genes, Xoshiro256 &prng)
+    {
+        genes[Index] = (uint8_t)prng.between(Field::min, Field::max);
+        Next::randomize(genes, prng);
+    }
+
+    static void clamp(uint8_t *genes)
+    {
+        genes[Index] = (uint8_t)clamp_gene(genes[Index], Field::min, Field::max);
+        Next::clamp(genes);
+    }
+
+    static void from_instrument(uint8_t *genes, const FmBank::Instrument &ins)
+    {
+        genes[Index] = (uint8_t)clamp_gene(Field::get(ins), Field::min, Field::max);
+        Next::from_instrument(genes, ins);
+    }
+
+    static void to_instrument(const uint8_t *genes, FmBank::Instrument &ins)
+    {
+        Field::set(ins, genes[Index]);
+        Next::to_instrument(genes, ins);
+    }
+
+    // `random` has 16 random bits for each gene
+    static void recombine(uint8_t *child, const uint8_t *genes1, const uint8_t *genes2, const uint16_t *random)
+    {
+        unsigned val1 = genes1[Index];
+        unsigned val2 = genes2[Index];
+        unsigned r = random[Index];
+        if (Field::flags & MP_Bits) {
+            /* Bitwise recombination */
+            child[Index] = (uint8_t)(((val1 & r) | (val2 & ~r)) & Field::max);
+        }
+        else {
+            /* Linear recombination */
+            double p = r * (1.0 / 65536);
+            double v = val1 * p + val2 * (1 - p);
+            child[Index] = (uint8_t)std::lround(v);
+        }
+        Next::recombine(child, genes1, genes2, random);
+    }
+};
+
+typedef GeneOps<InstrumentGenes> InstrumentGeneOps;
+typedef GeneRanges<InstrumentGenes> InstrumentGeneRanges;
+
+//
+// each gene which is not frozen mutates with this probability
+constexpr double mutation_rate = 0.01;
+
+inline void recombine_genes(uint8_t *child, const uint8_t *genes1, const uint8_t *genes2, Xoshiro256 &prng)
+{
+    // the random bits of all the genes, made by whole words
+    enum { num_words = (num_genes + 3) / 4 };
+    uint64_t words[num_words];
+    for (uint64_t &word : words)
+        word = prng();
+    uint16_t random[4 * num_words];
+    std::memcpy(random, words, sizeof(random));
+
+    InstrumentGeneOps::recombine(child, genes1, genes2, random);
+}
+
+// `frozen` has a bit for each gene which is left as it is; returns
+// whether any gene has mutated
+inline bool mutate_genes(uint8_t *genes, uint64_t frozen, Xoshiro256 &prng)
+{
+    static const double log_keep = std::log1p(-mutation_rate);
+
+    // skip ahead to the next mutation, by the geometric distribution of
+    // the number of genes left unchanged in between
+    uint64_t candidates = ~frozen & ((UINT64_C(1) << num_genes) - 1);
+    bool mutated = false;
+    for (;;) {
+        double skip = std::floor(std::log(1.0 - prng.uniform()) / log_keep);
+        if (skip >= count_bits(candidates))
+            return mutated;
+        for (unsigned n = (unsigned)skip; n > 0; --n)
+            candidates &= candidates - 1;
+
+        unsigned gene = lowest_bit(candidates);
+        candidates &= candidates - 1;
+        genes[gene] = (uint8_t)prng.between(InstrumentGeneRanges::min[gene], InstrumentGeneRanges::max[gene]);
+        mutated = true;
+    }
+}
+
+} // namespace ai
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <utility>
+#include <cstddef>
+
+namespace ai {
+
+// lock-free mailbox with any number of senders and a single receiver,
+// who takes all the items at once, oldest first
+template <class T>
+class Mailbox
+{
+public:
+    Mailbox() {}
+    ~Mailbox() { clear(); }
+
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    void post(T item)
+    {
+        Node *node = new Node{std::move(item), nullptr};
+        Node *head = head_.load(std::memory_order_relaxed);
+        do
+            node->next = head;
+        while (!head_.compare_exchange_weak(
+                   head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // whether there was nothing to receive, at the time of the call
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    template <class F> size_t receive(F &&f)
+    {
+        Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+
+        // the list is newest first, reverse it
+        Node *list = nullptr;
+        while (node) {
+            Node *next = node->next;
+            node->next = list;
+            list = node;
+            node = next;
+        }
+
+        size_t count = 0;
+        for (; list; ++count) {
+            Node *next = list->next;
+            f(std::move(list->item));
+            delete list;
+            list = next;
+        }
+        return count;
+    }
+
+    void clear()
+    {
+        receive([](T &&) {});
+    }
+
+private:
+    struct Node {
+        T item;
+        Node *next;
+    };
+
+    std::atomic<Node *> head_{nullptr};
+};
+
+} // namespace ai
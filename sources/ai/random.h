@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+
+namespace ai {
+
+// xoshiro256** by Blackman and Vigna: small, fast, with a period of
+// 2^256 - 1; independent streams are split off with jumps of 2^128 steps.
+// It is a uniform random bit generator for the standard distributions.
+class Xoshiro256
+{
+public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256(uint64_t seed = 0) noexcept { this->seed(seed); }
+
+    // the state is filled by SplitMix64 from the seed
+    void seed(uint64_t seed) noexcept
+    {
+        for (uint64_t &s : s_) {
+            uint64_t z = (seed += UINT64_C(0x9e3779b97f4a7c15));
+            z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+            z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+            s = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+    static constexpr result_type max() noexcept { return ~(result_type)0; }
+
+    result_type operator()() noexcept
+    {
+        uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // advance by 2^128 steps
+    void jump() noexcept
+    {
+        static const uint64_t poly[4] = {
+            UINT64_C(0x180ec6d33cfd0aba), UINT64_C(0xd5a61266f0c9392c),
+            UINT64_C(0xa9582618e03fc9aa), UINT64_C(0x39abdc4529b1661c),
+        };
+        uint64_t s[4] = {};
+        for (uint64_t word : poly) {
+            for (unsigned b = 0; b < 64; ++b) {
+                if (word & ((uint64_t)1 << b)) {
+                    for (unsigned i = 0; i < 4; ++i)
+                        s[i] ^= s_[i];
+                }
+                operator()();
+            }
+        }
+        for (unsigned i = 0; i < 4; ++i)
+            s_[i] = s[i];
+    }
+
+    // a generator for another stream, which this one then leaves behind
+    Xoshiro256 split() noexcept
+    {
+        Xoshiro256 other = *this;
+        jump();
+        return other;
+    }
+
+    // uniform in [0, 1)
+    double uniform() noexcept
+    {
+        return (double)(operator()() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // uniform in [0, n), for n > 0, by Lemire's multiplication method
+    uint32_t below(uint32_t n) noexcept
+    {
+        uint64_t m = (uint64_t)(uint32_t)(operator()() >> 32) * n;
+        if ((uint32_t)m < n) {
+            uint32_t threshold = (uint32_t)-n % n;
+            while ((uint32_t)m < threshold)
+                m = (uint64_t)(uint32_t)(operator()() >> 32) * n;
+        }
+        return (uint32_t)(m >> 32);
+    }
+
+    // uniform in [min, max]
+    unsigned between(unsigned min, unsigned max) noexcept
+    {
+        return min + below(max - min + 1);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, unsigned k) noexcept
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+private:
+    uint64_t s_[4];
+};
+
+} // namespace ai
@@ -0,0 +1,150 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace ai {
+
+// index of the worker running on this thread, or -1 for other threads
+static thread_local int worker_index = -1;
+static thread_local const ThreadPool *worker_pool = nullptr;
+
+ThreadPool::ThreadPool(unsigned num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers_.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i)
+        workers_.emplace_back(new Worker);
+    for (unsigned i = 0; i < num_threads; ++i)
+        workers_[i]->thread = std::thread([this, i]() { work(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        quit_ = true;
+    }
+    wake_cond_.notify_all();
+    for (std::unique_ptr<Worker> &worker : workers_)
+        worker->thread.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+    // workers push on their own queue, other threads spread the tasks
+    unsigned index;
+    if (worker_pool == this)
+        index = (unsigned)worker_index;
+    else
+        index = next_queue_.fetch_add(1, std::memory_order_relaxed) % size();
+
+    // count the task before it is published, else a worker may take it and
+    // decrement the count first
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        ++num_queued_;
+    }
+    Worker &worker = *workers_[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    wake_cond_.notify_one();
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t)> &body)
+{
+    grain = std::max<size_t>(1, grain);
+    size_t num_tasks = (count + grain - 1) / grain;
+    if (num_tasks == 0)
+        return;
+
+    // shared with the tasks, which may finish after the caller returns
+    struct Completion {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    std::shared_ptr<Completion> done(new Completion);
+    done->remaining = num_tasks;
+
+    for (size_t t = 0; t < num_tasks; ++t) {
+        size_t begin = t * grain;
+        size_t end = std::min(count, begin + grain);
+        submit([done, &body, begin, end]() {
+            for (size_t i = begin; i < end; ++i)
+                body(i);
+            std::lock_guard<std::mutex> lock(done->mutex);
+            if (--done->remaining == 0)
+                done->cond.notify_all();
+        });
+    }
+
+    // help with the work while it is not done
+    unsigned self = (worker_pool == this) ? (unsigned)worker_index : size();
+    Task task;
+    while (done->remaining > 0) {
+        bool found = (self < size()) ? pop_task(self, task) : false;
+        found = found || steal_task(self, task);
+        if (found) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(done->mutex);
+        done->cond.wait(lock, [&]() { return done->remaining == 0; });
+    }
+}
+
+void ThreadPool::work(unsigned index)
+{
+    worker_index = (int)index;
+    worker_pool = this;
+
+    Task task;
+    for (;;) {
+        if (pop_task(index, task) || steal_task(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cond_.wait(lock, [this]() { return quit_ || num_queued_ > 0; });
+        if (quit_)
+            return;
+    }
+}
+
+bool ThreadPool::pop_task(unsigned index, Task &task)
+{
+    Worker &worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+        return false;
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --num_queued_;
+    return true;
+}
+
+bool ThreadPool::steal_task(unsigned thief, Task &task)
+{
+    unsigned n = size();
+    for (unsigned k = 1; k <= n; ++k) {
+        unsigned index = (thief + k) % n;
+        if (index == thief)
+            continue;
+        Worker &worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            continue;
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        --num_queued_;
+        return true;
+    }
+    return false;
+}
+
+} // namespace ai
@@ -0,0 +1,54 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace ai {
+
+// persistent worker threads, each with a queue of its own; a worker takes
+// the newest of its own tasks first, and when it has none, it steals the
+// oldest task of another. Tasks may be submitted from any thread.
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // with 0 threads, there are as many as hardware threads
+    explicit ThreadPool(unsigned num_threads = 0);
+    ~ThreadPool();
+
+    unsigned size() const { return (unsigned)workers_.size(); }
+
+    void submit(Task task);
+
+    // run `body(i)` for i in [0, count), by tasks of `grain` indices each,
+    // and return when all is done; the calling thread takes part
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t)> &body);
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void work(unsigned index);
+    bool pop_task(unsigned index, Task &task);
+    bool steal_task(unsigned thief, Task &task);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<unsigned> next_queue_{0};
+    // number of tasks in queues, and how to wait for some
+    std::atomic<size_t> num_queued_{0};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cond_;
+    bool quit_ = false;
+};
+
+} // namespace ai
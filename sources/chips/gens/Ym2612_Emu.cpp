@@ -10,6 +10,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdint.h>
 
 /* Copyright (C) 2002 Stéphane Dallongeville (gens AT consolemul.com) */
 /* Copyright (C) 2004-2006 Shay Green. This module is free software; you
@@ -303,7 +304,9 @@ struct Ym2612_Impl
 	void write1( int addr, int data );
 	void write_pan(int channel, int data );
 	void run_timer( int );
+	void run_prepare( int pair_count );
 	void run( int pair_count, Ym2612_Emu::sample_t* );
+	void run_channels( int pair_count, int** );
 };
 
 void Ym2612_Impl::KEY_ON( channel_t& ch, int nsl)
@@ -1004,6 +1007,59 @@ void Ym2612_Emu::write_pan(int channel, int data)
 
 void Ym2612_Emu::mute_voices( int mask ) { impl->mute_mask = mask; }
 
+// fmprog: state snapshots
+
+struct ym2612_state_t
+{
+	void const* tables; // address of the tables of the chip which saved the state
+	state_t YM2612;
+	int LFOcnt;
+	int LFOinc;
+};
+
+// moves a pointer into the tables `from`, to the same place in `to`
+template<class T>
+static T* relocate_table( T* p, void const* from, tables_t& to )
+{
+	size_t offset = (size_t) ((uintptr_t) p - (uintptr_t) from);
+	if ( offset >= sizeof (tables_t) )
+		return p;
+	return (T*) ((char*) &to + offset);
+}
+
+int Ym2612_Emu::state_size() { return sizeof (ym2612_state_t); }
+
+void Ym2612_Emu::save_state( void* out ) const
+{
+	ym2612_state_t* st = (ym2612_state_t*) out;
+	st->tables = &impl->g;
+	st->YM2612 = impl->YM2612;
+	st->LFOcnt = impl->g.LFOcnt;
+	st->LFOinc = impl->g.LFOinc;
+}
+
+void Ym2612_Emu::load_state( void const* in )
+{
+	ym2612_state_t const* st = (ym2612_state_t const*) in;
+	tables_t& g = impl->g;
+	impl->YM2612 = st->YM2612;
+	g.LFOcnt = st->LFOcnt;
+	g.LFOinc = st->LFOinc;
+
+	for ( int i = 0; i < channel_count; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			slot_t& sl = impl->YM2612.CHANNEL [i].SLOT [j];
+			sl.DT = relocate_table( sl.DT, st->tables, g );
+			sl.AR = relocate_table( sl.AR, st->tables, g );
+			sl.DR = relocate_table( sl.DR, st->tables, g );
+			sl.SR = relocate_table( sl.SR, st->tables, g );
+			sl.RR = relocate_table( sl.RR, st->tables, g );
+		}
+	}
+}
+
 static void update_envelope_( slot_t* sl )
 {
 	switch ( sl->Ecurp )
@@ -1074,16 +1130,60 @@ inline void update_envelope( slot_t& sl )
 		update_envelope_( &sl );
 }
 
+// adds a channel into a stereo buffer, panned
+struct ym2612_stereo_out {
+	Ym2612_Emu::sample_t* buf;
+	void operator()( channel_t const& ch, int CH_OUTd )
+	{
+		int t0 = buf [0] + ((CH_OUTd * ch.PANVolumeL / 65535) & ch.LEFT);
+		int t1 = buf [1] + ((CH_OUTd * ch.PANVolumeR / 65535) & ch.RIGHT);
+		buf [0] = t0;
+		buf [1] = t1;
+		buf += 2;
+	}
+};
+
+// fmprog: stores a channel apart, at the level of a centered channel in
+// the stereo output
+struct ym2612_mono_out {
+	int* buf;
+	void operator()( channel_t const&, int CH_OUTd )
+	{
+		if ( buf )
+			*buf++ = CH_OUTd * 46340 / 65535;
+	}
+};
+
 template<int algo>
 struct ym2612_update_chan {
 	static void func( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int );
+	static void func_mono( tables_t&, channel_t&, int*, int );
+	template<class Out>
+	static void run( tables_t&, channel_t&, Out&, int );
 };
 
 typedef void (*ym2612_update_chan_t)( tables_t&, channel_t&, Ym2612_Emu::sample_t*, int );
+typedef void (*ym2612_update_chan_mono_t)( tables_t&, channel_t&, int*, int );
 
 template<int algo>
 void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 		Ym2612_Emu::sample_t* buf, int length )
+{
+	ym2612_stereo_out out = { buf };
+	run( g, ch, out, length );
+}
+
+template<int algo>
+void ym2612_update_chan<algo>::func_mono( tables_t& g, channel_t& ch,
+		int* buf, int length )
+{
+	ym2612_mono_out out = { buf };
+	run( g, ch, out, length );
+}
+
+template<int algo> template<class Out>
+void ym2612_update_chan<algo>::run( tables_t& g, channel_t& ch,
+		Out& out, int length )
 {
 	int not_end = ch.SLOT [S3].Ecnt - ENV_END;
 	
@@ -1210,8 +1310,7 @@ void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 		in2 += (ch.SLOT [S2].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
 		in3 += (ch.SLOT [S3].Finc * freq_LFO) >> (LFO_FMS_LBITS - 1);
 
-		int t0 = buf [0] + ((CH_OUTd * ch.PANVolumeL / 65535) & ch.LEFT);
-		int t1 = buf [1] + ((CH_OUTd * ch.PANVolumeR / 65535) & ch.RIGHT);
+		out( ch, CH_OUTd );
 
 		update_envelope( ch.SLOT [0] );
 		update_envelope( ch.SLOT [1] );
@@ -1219,9 +1318,6 @@ void ym2612_update_chan<algo>::func( tables_t& g, channel_t& ch,
 		update_envelope( ch.SLOT [3] );
 		
 		ch.S0_OUT [0] = CH_S0_OUT_0;
-		buf [0] = t0;
-		buf [1] = t1;
-		buf += 2;
 	}
 	while ( --length );
 	
@@ -1244,6 +1340,17 @@ static const ym2612_update_chan_t UPDATE_CHAN [8] = {
 	&ym2612_update_chan<7>::func
 };
 
+static const ym2612_update_chan_mono_t UPDATE_CHAN_MONO [8] = {
+	&ym2612_update_chan<0>::func_mono,
+	&ym2612_update_chan<1>::func_mono,
+	&ym2612_update_chan<2>::func_mono,
+	&ym2612_update_chan<3>::func_mono,
+	&ym2612_update_chan<4>::func_mono,
+	&ym2612_update_chan<5>::func_mono,
+	&ym2612_update_chan<6>::func_mono,
+	&ym2612_update_chan<7>::func_mono
+};
+
 void Ym2612_Impl::run_timer( int length )
 {
 	int const step = 6;
@@ -1290,11 +1397,8 @@ void Ym2612_Impl::run_timer( int length )
 	while ( remain > 0 );
 }
 
-void Ym2612_Impl::run( int pair_count, Ym2612_Emu::sample_t* out )
+void Ym2612_Impl::run_prepare( int pair_count )
 {
-	if ( pair_count <= 0 )
-		return;
-	
 	if ( YM2612.Mode & 3 )
 		run_timer( pair_count );
 	
@@ -1349,6 +1453,14 @@ void Ym2612_Impl::run( int pair_count, Ym2612_Emu::sample_t* out )
 				i2 = (i2 ^ 2) ^ (i2 >> 1);
 		}
 	}
+}
+
+void Ym2612_Impl::run( int pair_count, Ym2612_Emu::sample_t* out )
+{
+	if ( pair_count <= 0 )
+		return;
+	
+	run_prepare( pair_count );
 	
 	for ( int i = 0; i < channel_count; i++ )
 	{
@@ -1359,4 +1471,24 @@ void Ym2612_Impl::run( int pair_count, Ym2612_Emu::sample_t* out )
 	g.LFOcnt += g.LFOinc * pair_count;
 }
 
+void Ym2612_Impl::run_channels( int pair_count, int** out )
+{
+	if ( pair_count <= 0 )
+		return;
+	
+	run_prepare( pair_count );
+	
+	for ( int i = 0; i < channel_count; i++ )
+	{
+		if ( out [i] )
+			memset( out [i], 0, pair_count * sizeof out [i] [0] );
+		if ( !(mute_mask & (1 << i)) && (i != 5 || !YM2612.DAC) )
+			UPDATE_CHAN_MONO [YM2612.CHANNEL [i].ALGO]( g, YM2612.CHANNEL [i], out [i], pair_count );
+	}
+	
+	g.LFOcnt += g.LFOinc * pair_count;
+}
+
 void Ym2612_Emu::run( int pair_count, sample_t* out ) { impl->run( pair_count, out ); }
+
+void Ym2612_Emu::run_channels( int pair_count, int* out [channel_count] ) { impl->run_channels( pair_count, out ); }
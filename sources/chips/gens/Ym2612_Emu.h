@@ -29,6 +29,15 @@ public:
 	// Write addr to register 2 then data to register 3
 	void write1( int addr, int data );
 
+	// Size of the chip state, in bytes
+	static int state_size();
+
+	// Save the chip state into out, which is aligned for any type
+	void save_state( void* out ) const;
+
+	// Restore a state saved by a chip which has the same rates
+	void load_state( void const* in );
+
 	// Write pan level channel data
 	void write_pan( int channel, int data );
 
@@ -36,6 +45,10 @@ public:
 	typedef short sample_t;
 	enum { out_chan_count = 2 }; // stereo
 	void run( int pair_count, sample_t* out );
+
+	// Run and write pair_count samples of each channel apart, without
+	// panning, into the buffers which are not null
+	void run_channels( int pair_count, int* out [channel_count] );
 };
 
 #endif
@@ -72,6 +72,26 @@ void GensOPN2::nativeGenerateN(int16_t *output, size_t frames)
     chip->run((int)frames, output);
 }
 
+void GensOPN2::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    chip->run_channels((int)frames, output);
+}
+
+size_t GensOPN2::nativeStateSize() const
+{
+    return (size_t)Ym2612_Emu::state_size();
+}
+
+void GensOPN2::nativeSaveState(void *state) const
+{
+    chip->save_state(state);
+}
+
+void GensOPN2::nativeLoadState(const void *state)
+{
+    chip->load_state(state);
+}
+
 const char *GensOPN2::emulatorName()
 {
     return "GENS 2.10 OPN2";
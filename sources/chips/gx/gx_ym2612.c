@@ -151,6 +151,7 @@
 #include "../mame/mamedef.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 
 /* envelope generator */
@@ -1811,6 +1812,8 @@ static void reset_channels(FM_CH *CH , int num )
 }
 
 /* initialize generic tables */
+/* fmprog: the tables are shared by the chips, and built by the first of
+   them; see YM2612GXInitTables() for chips initialized in several threads */
 static int tables_ready = 0;
 static void init_tables()
 {
@@ -1914,6 +1917,12 @@ static void init_tables()
   tables_ready = 1;
 }
 
+/* build the shared tables ahead of YM2612GXInit() */
+void YM2612GXInitTables(void)
+{
+  init_tables();
+}
+
 YM2612 *YM2612GXAlloc()
 {
     YM2612 *ym2612 = (YM2612 *)malloc(sizeof(YM2612));
@@ -2002,6 +2011,54 @@ void YM2612GXResetChip(YM2612 *ym2612)
   }
 }
 
+/* fmprog: state snapshots */
+typedef struct
+{
+  const void *base;  /* address of the chip which saved the state */
+  YM2612 chip;
+} YM2612_STATE;
+
+/* moves a pointer into the chip `from`, to the same place in the chip `to` */
+static void *state_relocate(const void *p, const void *from, void *to)
+{
+  uintptr_t offset = (uintptr_t)p - (uintptr_t)from;
+  if (offset >= sizeof(YM2612))
+    return (void *)p;
+  return (UINT8 *)to + offset;
+}
+
+size_t YM2612GXStateSize(void)
+{
+  return sizeof(YM2612_STATE);
+}
+
+void YM2612GXSaveState(YM2612 *ym2612, void *state)
+{
+  YM2612_STATE *st = (YM2612_STATE *)state;
+  st->base = ym2612;
+  memcpy(&st->chip, ym2612, sizeof(YM2612));
+}
+
+void YM2612GXLoadState(YM2612 *ym2612, const void *state)
+{
+  const YM2612_STATE *st = (const YM2612_STATE *)state;
+  int c, s;
+
+  memcpy(ym2612, &st->chip, sizeof(YM2612));
+
+  for (c = 0; c < 6; c++)
+  {
+    FM_CH *CH = &ym2612->CH[c];
+    CH->connect1 = (INT32 *)state_relocate(CH->connect1, st->base, ym2612);
+    CH->connect2 = (INT32 *)state_relocate(CH->connect2, st->base, ym2612);
+    CH->connect3 = (INT32 *)state_relocate(CH->connect3, st->base, ym2612);
+    CH->connect4 = (INT32 *)state_relocate(CH->connect4, st->base, ym2612);
+    CH->mem_connect = (INT32 *)state_relocate(CH->mem_connect, st->base, ym2612);
+    for (s = 0; s < 4; s++)
+      CH->SLOT[s].DT = (INT32 *)state_relocate(CH->SLOT[s].DT, st->base, ym2612);
+  }
+}
+
 /* ym2612 write */
 /* n = number  */
 /* a = address */
@@ -2093,9 +2150,9 @@ void YM2612GXPostGenerate(YM2612GX *ym2612, unsigned int count)
   INTERNAL_TIMER_B(ym2612, count);
 }
 
-void YM2612GXGenerateOneNative(YM2612GX *ym2612, FMSAMPLE *frame)
+/* compute the channel outputs of the next sample into out_fm, and advance the chip */
+static void step_native(YM2612GX *ym2612)
 {
-  int lt,rt;
   INT32 *out_fm = ym2612->out_fm;
 
   /* clear outputs */
@@ -2156,6 +2213,32 @@ void YM2612GXGenerateOneNative(YM2612GX *ym2612, FMSAMPLE *frame)
   if (out_fm[5] > 8191) out_fm[5] = 8191;
   else if (out_fm[5] < -8192) out_fm[5] = -8192;
 
+  /* CSM mode: if CSM Key ON has occurred, CSM Key OFF need to be sent      */
+  /* only if Timer A does not overflow again (i.e CSM Key ON not set again) */
+  ym2612->OPN.SL3.key_csm <<= 1;
+
+  /* timer A control */
+  INTERNAL_TIMER_A(ym2612);
+
+  /* CSM Mode Key ON still disabled */
+  if (ym2612->OPN.SL3.key_csm & 2)
+  {
+    /* CSM Mode Key OFF (verified by Nemesis on real hardware) */
+    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT1);
+    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT2);
+    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT3);
+    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT4);
+    ym2612->OPN.SL3.key_csm = 0;
+  }
+}
+
+void YM2612GXGenerateOneNative(YM2612GX *ym2612, FMSAMPLE *frame)
+{
+  int lt,rt;
+  INT32 *out_fm = ym2612->out_fm;
+
+  step_native(ym2612);
+
 #define PANLAW_L(ch, chpan) ((out_fm[ch] * ym2612->CH[ch].pan_volume_l / 65535) & ym2612->OPN.pan[chpan]);
 #define PANLAW_R(ch, chpan) ((out_fm[ch] * ym2612->CH[ch].pan_volume_r / 65535) & ym2612->OPN.pan[chpan]);
 
@@ -2202,23 +2285,30 @@ void YM2612GXGenerateOneNative(YM2612GX *ym2612, FMSAMPLE *frame)
   /* buffering */
   frame[0] = lt / 2;
   frame[1] = rt / 2;
+}
 
-  /* CSM mode: if CSM Key ON has occurred, CSM Key OFF need to be sent      */
-  /* only if Timer A does not overflow again (i.e CSM Key ON not set again) */
-  ym2612->OPN.SL3.key_csm <<= 1;
-
-  /* timer A control */
-  INTERNAL_TIMER_A(ym2612);
+void YM2612GXGenerateChannelsNative(YM2612GX *ym2612, int **buffers, unsigned int count)
+{
+  INT32 *out_fm = ym2612->out_fm;
+  unsigned int i;
+  int c;
 
-  /* CSM Mode Key ON still disabled */
-  if (ym2612->OPN.SL3.key_csm & 2)
+  for (i = 0; i < count; i++)
   {
-    /* CSM Mode Key OFF (verified by Nemesis on real hardware) */
-    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT1);
-    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT2);
-    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT3);
-    FM_KEYOFF_CSM(&ym2612->CH[2],SLOT4);
-    ym2612->OPN.SL3.key_csm = 0;
+    step_native(ym2612);
+
+    /* at the level of a centered channel in the stereo output */
+    for (c = 0; c < 6; c++)
+    {
+      int out;
+      if (!buffers[c])
+        continue;
+      out = out_fm[c] * 46340 / 65535;
+      /* discrete YM2612 DAC 'ladder effect' */
+      if (ym2612->chip_type == YM2612_DISCRETE)
+        out += (out_fm[c] < 0) ? -(3 << 5) : (4 << 5);
+      buffers[c][i] = out / 2;
+    }
   }
 }
 
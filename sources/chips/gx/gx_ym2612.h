@@ -18,6 +18,8 @@
 #ifndef _H_YM2612_
 #define _H_YM2612_
 
+#include <stddef.h>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -34,14 +36,21 @@ typedef struct YM2612GX YM2612GX;
 /* typedef signed int FMSAMPLE; */
 typedef signed short FMSAMPLE;
 
+/* fmprog: call once before initializing chips from several threads at once */
+extern void YM2612GXInitTables(void);
 extern YM2612GX *YM2612GXAlloc();
 extern void YM2612GXFree(YM2612GX *ym2612);
 extern void YM2612GXInit(YM2612GX *ym2612);
 extern void YM2612GXConfig(YM2612GX *ym2612, int type);
 extern void YM2612GXResetChip(YM2612GX *ym2612);
+/* fmprog: the state can be loaded in a chip of the same configuration */
+extern size_t YM2612GXStateSize(void);
+extern void YM2612GXSaveState(YM2612GX *ym2612, void *state);
+extern void YM2612GXLoadState(YM2612GX *ym2612, const void *state);
 extern void YM2612GXPreGenerate(YM2612GX *ym2612);
 extern void YM2612GXPostGenerate(YM2612GX *ym2612, unsigned int count);
 extern void YM2612GXGenerateOneNative(YM2612GX *ym2612, FMSAMPLE *frame);
+extern void YM2612GXGenerateChannelsNative(YM2612GX *ym2612, int **buffers, unsigned int count);
 extern void YM2612GXWrite(YM2612GX *ym2612, unsigned int a, unsigned int v);
 extern void YM2612GXWritePan(YM2612GX *chip, int c, unsigned char v);
 extern unsigned int YM2612GXRead(YM2612GX *ym2612);
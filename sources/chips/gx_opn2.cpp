@@ -20,14 +20,20 @@
 
 #include "gx_opn2.h"
 #include <cstring>
+#include <mutex>
 
 #include "gx/gx_ym2612.h"
 
+// YM2612GXInit() would build the shared tables the first time, which
+// races when chips are made in several threads: build them beforehand
+static std::once_flag tables;
+
 GXOPN2::GXOPN2(OPNFamily f)
     : OPNChipBaseT(f),
       m_chip(YM2612GXAlloc()),
       m_framecount(0)
 {
+    std::call_once(tables, YM2612GXInitTables);
     YM2612GXInit(m_chip);
     YM2612GXConfig(m_chip, YM2612_DISCRETE);
     setRate(m_rate, m_clock);
@@ -47,6 +53,10 @@ void GXOPN2::setRate(uint32_t rate, uint32_t clock)
 void GXOPN2::reset()
 {
     OPNChipBaseT::reset();
+    // YM2612GXResetChip() leaves envelope state behind, which is audible
+    // on the next note; initialize the chip again to make it as good as new
+    YM2612GXInit(m_chip);
+    YM2612GXConfig(m_chip, YM2612_DISCRETE);
     YM2612GXResetChip(m_chip);
 }
 
@@ -78,6 +88,27 @@ void GXOPN2::nativeGenerate(int16_t *frame)
     ++m_framecount;
 }
 
+void GXOPN2::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    YM2612GXGenerateChannelsNative(m_chip, output, (unsigned int)frames);
+    m_framecount += (unsigned int)frames;
+}
+
+size_t GXOPN2::nativeStateSize() const
+{
+    return YM2612GXStateSize();
+}
+
+void GXOPN2::nativeSaveState(void *state) const
+{
+    YM2612GXSaveState(m_chip, state);
+}
+
+void GXOPN2::nativeLoadState(const void *state)
+{
+    YM2612GXLoadState(m_chip, state);
+}
+
 const char *GXOPN2::emulatorName()
 {
     return "Genesis Plus GX";
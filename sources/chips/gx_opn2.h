@@ -40,6 +40,10 @@ public:
     void nativePreGenerate() override;
     void nativePostGenerate() override;
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateChannels(int32_t *output[6], size_t frames);
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeLoadState(const void *state);
     const char *emulatorName() override;
 };
 
@@ -0,0 +1,928 @@
+// ---------------------------------------------------------------------------
+//	FM Lanes: 4-operator channels computed in lockstep in SIMD lanes
+// ---------------------------------------------------------------------------
+
+#include "fm_lanes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// fmgen constants
+#define FM_OPSINBITS    10
+#define FM_OPSINENTS    (1 << FM_OPSINBITS)
+#define FM_PGBITS       9
+#define FM_RATIOBITS    7
+#define FM_LFOCBITS     14
+#define FM_LFOENTS      256
+#define FM_CLENTS       (0x1000 * 2)
+#define FM_EG_BOTTOM    955
+#define IS2EC_SHIFT     ((20 + FM_PGBITS) - 13)
+
+namespace FMLanes
+{
+
+// ---------------------------------------------------------------------------
+//	Tables
+//
+static const uint8_t notetable[128] =
+{
+     0,  0,  0,  0,  0,  0,  0,  1,  2,  3,  3,  3,  3,  3,  3,  3,
+     4,  4,  4,  4,  4,  4,  4,  5,  6,  7,  7,  7,  7,  7,  7,  7,
+     8,  8,  8,  8,  8,  8,  8,  9, 10, 11, 11, 11, 11, 11, 11, 11,
+    12, 12, 12, 12, 12, 12, 12, 13, 14, 15, 15, 15, 15, 15, 15, 15,
+    16, 16, 16, 16, 16, 16, 16, 17, 18, 19, 19, 19, 19, 19, 19, 19,
+    20, 20, 20, 20, 20, 20, 20, 21, 22, 23, 23, 23, 23, 23, 23, 23,
+    24, 24, 24, 24, 24, 24, 24, 25, 26, 27, 27, 27, 27, 27, 27, 27,
+    28, 28, 28, 28, 28, 28, 28, 29, 30, 31, 31, 31, 31, 31, 31, 31,
+};
+
+static const int8_t dttable[256] =
+{
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  2,  2,  2,  2,  2,  2,  2,  2,  4,  4,  4,  4,
+      4,  6,  6,  6,  8,  8,  8, 10, 10, 12, 12, 14, 16, 16, 16, 16,
+      2,  2,  2,  2,  4,  4,  4,  4,  4,  6,  6,  6,  8,  8,  8, 10,
+     10, 12, 12, 14, 16, 16, 18, 20, 22, 24, 26, 28, 32, 32, 32, 32,
+      4,  4,  4,  4,  4,  6,  6,  6,  8,  8,  8, 10, 10, 12, 12, 14,
+     16, 16, 18, 20, 22, 24, 26, 28, 32, 34, 38, 40, 44, 44, 44, 44,
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0, -2, -2, -2, -2, -2, -2, -2, -2, -4, -4, -4, -4,
+     -4, -6, -6, -6, -8, -8, -8,-10,-10,-12,-12,-14,-16,-16,-16,-16,
+     -2, -2, -2, -2, -4, -4, -4, -4, -4, -6, -6, -6, -8, -8, -8,-10,
+    -10,-12,-12,-14,-16,-16,-18,-20,-22,-24,-26,-28,-32,-32,-32,-32,
+     -4, -4, -4, -4, -4, -6, -6, -6, -8, -8, -8,-10,-10,-12,-12,-14,
+    -16,-16,-18,-20,-22,-24,-26,-28,-32,-34,-38,-40,-44,-44,-44,-44,
+};
+
+static const int8_t decaytable1[64][8] =
+{
+    {0, 0, 0, 0, 0, 0, 0, 0},       {0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 1, 1, 1, 1, 1, 1, 1},       {1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 1, 1, 1, 1, 1, 1, 1},       {1, 1, 1, 1, 1, 1, 1, 1},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 0, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 0, 1, 0, 1, 0, 1, 0},       {1, 1, 1, 0, 1, 0, 1, 0},
+    {1, 1, 1, 0, 1, 1, 1, 0},       {1, 1, 1, 1, 1, 1, 1, 0},
+    {1, 1, 1, 1, 1, 1, 1, 1},       {2, 1, 1, 1, 2, 1, 1, 1},
+    {2, 1, 2, 1, 2, 1, 2, 1},       {2, 2, 2, 1, 2, 2, 2, 1},
+    {2, 2, 2, 2, 2, 2, 2, 2},       {4, 2, 2, 2, 4, 2, 2, 2},
+    {4, 2, 4, 2, 4, 2, 4, 2},       {4, 4, 4, 2, 4, 4, 4, 2},
+    {4, 4, 4, 4, 4, 4, 4, 4},       {8, 4, 4, 4, 8, 4, 4, 4},
+    {8, 4, 8, 4, 8, 4, 8, 4},       {8, 8, 8, 4, 8, 8, 8, 4},
+    {16,16,16,16,16,16,16,16},      {16,16,16,16,16,16,16,16},
+    {16,16,16,16,16,16,16,16},      {16,16,16,16,16,16,16,16},
+};
+
+static const int decaytable2[16] =
+{
+    1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2047, 2047, 2047, 2047, 2047
+};
+
+static const int8_t attacktable[64][8] =
+{
+    {-1,-1,-1,-1,-1,-1,-1,-1},  {-1,-1,-1,-1,-1,-1,-1,-1},
+    { 4, 4, 4, 4, 4, 4, 4, 4},  { 4, 4, 4, 4, 4, 4, 4, 4},
+    { 4, 4, 4, 4, 4, 4, 4, 4},  { 4, 4, 4, 4, 4, 4, 4, 4},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4,-1, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4,-1, 4,-1, 4,-1, 4,-1},  { 4, 4, 4,-1, 4,-1, 4,-1},
+    { 4, 4, 4,-1, 4, 4, 4,-1},  { 4, 4, 4, 4, 4, 4, 4,-1},
+    { 4, 4, 4, 4, 4, 4, 4, 4},  { 3, 4, 4, 4, 3, 4, 4, 4},
+    { 3, 4, 3, 4, 3, 4, 3, 4},  { 3, 3, 3, 4, 3, 3, 3, 4},
+    { 3, 3, 3, 3, 3, 3, 3, 3},  { 2, 3, 3, 3, 2, 3, 3, 3},
+    { 2, 3, 2, 3, 2, 3, 2, 3},  { 2, 2, 2, 3, 2, 2, 2, 3},
+    { 2, 2, 2, 2, 2, 2, 2, 2},  { 1, 2, 2, 2, 1, 2, 2, 2},
+    { 1, 2, 1, 2, 1, 2, 1, 2},  { 1, 1, 1, 2, 1, 1, 1, 2},
+    { 0, 0, 0, 0, 0, 0, 0, 0},  { 0, 0 ,0, 0, 0, 0, 0, 0},
+    { 0, 0, 0, 0, 0, 0, 0, 0},  { 0, 0 ,0, 0, 0, 0, 0, 0},
+};
+
+static const uint8_t fbtable[8] = { 31, 7, 6, 5, 4, 3, 2, 1 };
+static const uint8_t sltable[16] =
+{
+      0,   4,   8,  12,  16,  20,  24,  28,
+     32,  36,  40,  44,  48,  52,  56, 124,
+};
+static const uint8_t slottable[4] = { 0, 2, 1, 3 };
+// shift of the LFO amplitude by the AM sensitivity, 31 mutes it
+static const uint8_t amshifttable[4] = { 31, 6, 4, 3 };
+
+// routing of the algorithms: inputs of operator 2 (from 0, 1), of
+// operator 1 (from 0), of operator 3 (from 0, 1, 2), and the carriers
+static const uint8_t routetable[8][10] =
+{
+    { 0, 1,  1,  0, 0, 1,  0, 0, 0, 1 },
+    { 1, 1,  0,  0, 0, 1,  0, 0, 0, 1 },
+    { 0, 1,  0,  1, 0, 1,  0, 0, 0, 1 },
+    { 0, 0,  1,  0, 1, 1,  0, 0, 0, 1 },
+    { 0, 0,  1,  0, 0, 1,  0, 1, 0, 1 },
+    { 1, 0,  1,  1, 0, 0,  0, 1, 1, 1 },
+    { 0, 0,  1,  0, 0, 0,  0, 1, 1, 1 },
+    { 0, 0,  0,  0, 0, 0,  1, 1, 1, 1 },
+};
+
+// tables computed at startup, by the equations of fmgen
+struct Tables
+{
+    // the log-to-linear table, extended with silence so that any sum of
+    // envelope, sine and AM levels can be looked up without a bound check
+    int32_t cl[2 * FM_CLENTS];
+    int32_t sine[FM_OPSINENTS];
+    int32_t pm[8 * FM_LFOENTS];
+    int32_t lfo_am[FM_LFOENTS];
+
+    Tables();
+};
+
+Tables::Tables()
+{
+    int32_t *p = cl;
+    for (int i = 0; i < 256; i++)
+    {
+        int v = int(std::floor(std::pow(2., 13. - i / 256.)));
+        v = (v + 2) & ~3;
+        *p++ = v;
+        *p++ = -v;
+    }
+    for (; p < cl + FM_CLENTS; p++)
+        *p = p[-512] / 2;
+    for (; p < cl + 2 * FM_CLENTS; p++)
+        *p = 0;
+
+    double log2 = std::log(2.);
+    for (int i = 0; i < FM_OPSINENTS / 2; i++)
+    {
+        double r = (i * 2 + 1) * 3.14159265358979323846 / FM_OPSINENTS;
+        double q = -256 * std::log(std::sin(r)) / log2;
+        int s = int(std::floor(q + 0.5)) + 1;
+        sine[i] = s * 2;
+        sine[FM_OPSINENTS / 2 + i] = s * 2 + 1;
+    }
+    // envelope 0x3ff << 3, and AM 0xfc << 3 at most
+    assert(0x3ff * 8 + sine[FM_OPSINENTS / 2] + 0xfc * 8 < 2 * FM_CLENTS);
+
+    static const double pms[8] =
+    {
+        0, 1/360., 2/360., 3/360.,  4/360.,  6/360., 12/360.,  24/360.,
+    };
+    for (int i = 0; i < 8; i++)
+    {
+        for (int j = 0; j < FM_LFOENTS; j++)
+        {
+            double w = 0.6 * pms[i] * std::sin(2 * j * 3.14159265358979323846 / FM_LFOENTS) + 1;
+            pm[i * FM_LFOENTS + j] = int(0x10000 * (w - 1));
+        }
+    }
+
+    for (int c = 0; c < FM_LFOENTS; c++)
+    {
+        int v = (c < 0x80) ? (0xff - c * 2) : ((c - 0x80) * 2);
+        lfo_am[c] = v & ~3;
+    }
+}
+
+static const Tables &tables()
+{
+    static const Tables t;
+    return t;
+}
+
+// ---------------------------------------------------------------------------
+//	Vectors of lanes
+//
+//	integer vectors of N lanes of 32 bits, where masks have all the bits
+//	of a lane set or clear; the generic version is left to the compiler
+//	to vectorize
+template <unsigned N>
+struct GenericVec
+{
+    int32_t v[N];
+
+    static GenericVec load(const void *p)
+        { GenericVec r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+    void store(void *p) const
+        { std::memcpy(p, v, sizeof(v)); }
+    static GenericVec set1(int32_t x)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = x; return r; }
+    static GenericVec gather(const int32_t *table, GenericVec index)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = table[index.v[i]]; return r; }
+
+    friend GenericVec operator+(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i]); return r; }
+    friend GenericVec operator-(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i]); return r; }
+    friend GenericVec operator&(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = a.v[i] & b.v[i]; return r; }
+    friend GenericVec operator|(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = a.v[i] | b.v[i]; return r; }
+    // ~a & b
+    static GenericVec andnot(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = ~a.v[i] & b.v[i]; return r; }
+    static GenericVec mullo(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (int32_t)((uint32_t)a.v[i] * (uint32_t)b.v[i]); return r; }
+
+    template <int S> GenericVec sll() const
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (int32_t)((uint32_t)v[i] << S); return r; }
+    template <int S> GenericVec srl() const
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (int32_t)((uint32_t)v[i] >> S); return r; }
+    template <int S> GenericVec sra() const
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = v[i] >> S; return r; }
+    GenericVec srav(GenericVec s) const
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = v[i] >> s.v[i]; return r; }
+
+    static GenericVec cmpgt(GenericVec a, GenericVec b)
+        { GenericVec r; for (unsigned i = 0; i < N; ++i) r.v[i] = (a.v[i] > b.v[i]) ? -1 : 0; return r; }
+    unsigned bits() const
+        { unsigned r = 0; for (unsigned i = 0; i < N; ++i) r |= (v[i] ? 1u : 0u) << i; return r; }
+};
+
+#if defined(__AVX2__)
+struct Avx2Vec
+{
+    __m256i v;
+
+    static Avx2Vec make(__m256i x) { Avx2Vec r; r.v = x; return r; }
+    static Avx2Vec load(const void *p)
+        { return make(_mm256_loadu_si256(static_cast<const __m256i *>(p))); }
+    void store(void *p) const
+        { _mm256_storeu_si256(static_cast<__m256i *>(p), v); }
+    static Avx2Vec set1(int32_t x)
+        { return make(_mm256_set1_epi32(x)); }
+    static Avx2Vec gather(const int32_t *table, Avx2Vec index)
+        { return make(_mm256_i32gather_epi32(reinterpret_cast<const int *>(table), index.v, 4)); }
+
+    friend Avx2Vec operator+(Avx2Vec a, Avx2Vec b) { return make(_mm256_add_epi32(a.v, b.v)); }
+    friend Avx2Vec operator-(Avx2Vec a, Avx2Vec b) { return make(_mm256_sub_epi32(a.v, b.v)); }
+    friend Avx2Vec operator&(Avx2Vec a, Avx2Vec b) { return make(_mm256_and_si256(a.v, b.v)); }
+    friend Avx2Vec operator|(Avx2Vec a, Avx2Vec b) { return make(_mm256_or_si256(a.v, b.v)); }
+    static Avx2Vec andnot(Avx2Vec a, Avx2Vec b) { return make(_mm256_andnot_si256(a.v, b.v)); }
+    static Avx2Vec mullo(Avx2Vec a, Avx2Vec b) { return make(_mm256_mullo_epi32(a.v, b.v)); }
+
+    template <int S> Avx2Vec sll() const { return make(_mm256_slli_epi32(v, S)); }
+    template <int S> Avx2Vec srl() const { return make(_mm256_srli_epi32(v, S)); }
+    template <int S> Avx2Vec sra() const { return make(_mm256_srai_epi32(v, S)); }
+    Avx2Vec srav(Avx2Vec s) const { return make(_mm256_srav_epi32(v, s.v)); }
+
+    static Avx2Vec cmpgt(Avx2Vec a, Avx2Vec b) { return make(_mm256_cmpgt_epi32(a.v, b.v)); }
+    unsigned bits() const
+        { return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(v)); }
+};
+#endif
+
+#if defined(__AVX512F__)
+// the masked forms of the shifts, the gather and andnot, with every lane
+// enabled: GCC defines the plain forms with an undefined source operand,
+// which -Wmaybe-uninitialized reports once they are inlined
+struct Avx512Vec
+{
+    enum : __mmask16 { all = 0xffff };
+
+    __m512i v;
+
+    static Avx512Vec make(__m512i x) { Avx512Vec r; r.v = x; return r; }
+    static Avx512Vec load(const void *p)
+        { return make(_mm512_loadu_si512(p)); }
+    void store(void *p) const
+        { _mm512_storeu_si512(p, v); }
+    static Avx512Vec set1(int32_t x)
+        { return make(_mm512_set1_epi32(x)); }
+    static Avx512Vec gather(const int32_t *table, Avx512Vec index)
+        { return make(_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), all, index.v, table, 4)); }
+
+    friend Avx512Vec operator+(Avx512Vec a, Avx512Vec b) { return make(_mm512_add_epi32(a.v, b.v)); }
+    friend Avx512Vec operator-(Avx512Vec a, Avx512Vec b) { return make(_mm512_sub_epi32(a.v, b.v)); }
+    friend Avx512Vec operator&(Avx512Vec a, Avx512Vec b) { return make(_mm512_and_si512(a.v, b.v)); }
+    friend Avx512Vec operator|(Avx512Vec a, Avx512Vec b) { return make(_mm512_or_si512(a.v, b.v)); }
+    static Avx512Vec andnot(Avx512Vec a, Avx512Vec b) { return make(_mm512_maskz_andnot_epi32(all, a.v, b.v)); }
+    static Avx512Vec mullo(Avx512Vec a, Avx512Vec b) { return make(_mm512_mullo_epi32(a.v, b.v)); }
+
+    template <int S> Avx512Vec sll() const { return make(_mm512_maskz_slli_epi32(all, v, S)); }
+    template <int S> Avx512Vec srl() const { return make(_mm512_maskz_srli_epi32(all, v, S)); }
+    template <int S> Avx512Vec sra() const { return make(_mm512_maskz_srai_epi32(all, v, S)); }
+    Avx512Vec srav(Avx512Vec s) const { return make(_mm512_maskz_srav_epi32(all, v, s.v)); }
+
+    static Avx512Vec cmpgt(Avx512Vec a, Avx512Vec b)
+        { return make(_mm512_maskz_set1_epi32(_mm512_cmpgt_epi32_mask(a.v, b.v), -1)); }
+    unsigned bits() const
+        { return (unsigned)_mm512_test_epi32_mask(v, v); }
+};
+#endif
+
+template <unsigned N> struct VecFor { typedef GenericVec<N> type; };
+#if defined(__AVX2__)
+template <> struct VecFor<8> { typedef Avx2Vec type; };
+#endif
+#if defined(__AVX512F__)
+template <> struct VecFor<16> { typedef Avx512Vec type; };
+#endif
+
+template <class V>
+static inline V blend(V mask, V a, V b)
+{
+    return (mask & a) | V::andnot(mask, b);
+}
+
+static inline unsigned lowest_lane(unsigned bits)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(bits);
+#else
+    unsigned n = 0;
+    for (; !(bits & 1); bits >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+//	Bank
+//
+template <unsigned Lanes>
+Bank<Lanes>::Bank()
+{
+    tables();
+
+    // the state of fmgen, which is constructed in zeroed memory
+    std::memset(static_cast<void *>(this), 0, sizeof(*this));
+    for (unsigned l = 0; l < Lanes; ++l)
+    {
+        for (unsigned o = 0; o < 4; ++o)
+            am_shift_[o][l] = amshifttable[0];
+        set_fb_algorithm(l, 0);
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_ratio(uint32_t ratio)
+{
+    static const uint8_t table2[8] = { 108,  77,  71,  67,  62,  44,  8,  5 };
+
+    ratio_ = ratio;
+    for (unsigned l = 0; l < 16; ++l)
+        multable_[l] = (l ? l * 2 : 1) * ratio;
+    for (unsigned i = 0; i < 8; ++i)
+        lfotable_[i] = (ratio << (2 + FM_LFOCBITS - FM_RATIOBITS)) / table2[i];
+
+    // like in fmgen, the envelopes keep their steps until their next
+    // change of rate, and the LFO until its register is written
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::reset()
+{
+    for (unsigned l = 0; l < Lanes; ++l)
+        reset_lane(l);
+    lfocount_ = 0;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::reset_lane(unsigned lane)
+{
+    for (unsigned o = 0; o < 4; ++o)
+        reset_operator(o, lane);
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::reset_operator(unsigned o, unsigned l)
+{
+    Operator &op = op_[o][l];
+    op.tl = op.tl_latch = 127;
+    op.keyon = false;
+    op.key_scale_rate = 0;
+    op.tl_out = 0;
+    shift_phase(o, l, eg_off);
+    eg_count_[o][l] = 0;
+    op.eg_curve_count = 0;
+    op.inverted = false;
+    op.held = false;
+    pg_count_[o][l] = 0;
+    out_[o][l] = 0;
+    if (o == 0)
+        fb_out_[l] = 0;
+    op.param_changed = true;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_operator_reg(unsigned lane, unsigned addr, unsigned data)
+{
+    if ((addr & 3) == 3)
+        return;
+
+    Operator &op = op_[slottable[(addr >> 2) & 3]][lane];
+    switch ((addr >> 4) & 15)
+    {
+    case 3: // 30-3E DT/MULTI
+        op.detune = ((data >> 4) & 0x07) * 0x20;
+        op.multiple = data & 0x0f;
+        break;
+    case 4: // 40-4E TL
+        op.tl = op.tl_latch = data & 0x7f;
+        break;
+    case 5: // 50-5E KS/AR
+        op.ks = (data >> 6) & 3;
+        op.ar = (data & 0x1f) * 2;
+        break;
+    case 6: // 60-6E DR/AMON
+        op.dr = (data & 0x1f) * 2;
+        op.amon = (data & 0x80) != 0;
+        break;
+    case 7: // 70-7E SR
+        op.sr = (data & 0x1f) * 2;
+        break;
+    case 8: // 80-8E SL/RR
+        op.sl = sltable[(data >> 4) & 15];
+        op.rr = (data & 0x0f) * 4 + 2;
+        break;
+    case 9: // 90-9E SSG-EC, which leaves the parameters as they are
+        op.ssg_type = (data & 8) ? (data & 0x0f) : 0;
+        return;
+    default:
+        return;
+    }
+    op.param_changed = true;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_fnum(unsigned lane, unsigned fnum)
+{
+    for (unsigned o = 0; o < 4; ++o)
+    {
+        Operator &op = op_[o][lane];
+        op.dp = (fnum & 2047) << ((fnum >> 11) & 7);
+        op.bn = notetable[(fnum >> 7) & 127];
+        op.param_changed = true;
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_fb_algorithm(unsigned lane, unsigned data)
+{
+    unsigned fb = fbtable[(data >> 3) & 7];
+    unsigned algo = data & 7;
+
+    fb_shift_[lane] = (int32_t)fb;
+    fb_mask_[lane] = (fb < 31) ? -1 : 0;
+
+    const uint8_t *route = routetable[algo];
+    in2_[0][lane] = -(int32_t)route[0];
+    in2_[1][lane] = -(int32_t)route[1];
+    in1_[lane] = -(int32_t)route[2];
+    for (unsigned i = 0; i < 3; ++i)
+        in3_[i][lane] = -(int32_t)route[3 + i];
+    for (unsigned i = 0; i < 4; ++i)
+        carrier_[i][lane] = -(int32_t)route[6 + i];
+
+    out_[0][lane] = 0;
+    fb_out_[lane] = 0;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_ms(unsigned lane, unsigned ms)
+{
+    for (unsigned o = 0; o < 4; ++o)
+    {
+        op_[o][lane].ms = ms;
+        op_[o][lane].param_changed = true;
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::key_control(unsigned lane, unsigned key)
+{
+    for (unsigned o = 0; o < 4; ++o)
+    {
+        if (key & (1 << o))
+            key_on(o, lane);
+        else
+            key_off(o, lane);
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::set_lfo(unsigned data)
+{
+    unsigned modified = reg22_ ^ data;
+    reg22_ = data;
+    if (modified & 0x8)
+        lfocount_ = 0;
+    lfodcount_ = (reg22_ & 8) ? lfotable_[reg22_ & 7] : 0;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::key_on(unsigned o, unsigned l)
+{
+    Operator &op = op_[o][l];
+    if (!op.keyon)
+    {
+        op.keyon = true;
+        op.held = false;
+        if (op.eg_phase == eg_off || op.eg_phase == eg_release)
+        {
+            op.inverted = (op.ssg_type & 4) != 0;
+            op.inverted ^= (op.ssg_type & 2) && op.ar != 62;
+            shift_phase(o, l, eg_attack);
+            eg_update(o, l);
+            out_[o][l] = 0;
+            if (o == 0)
+                fb_out_[l] = 0;
+            pg_count_[o][l] = 0;
+        }
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::key_off(unsigned o, unsigned l)
+{
+    Operator &op = op_[o][l];
+    if (op.keyon)
+    {
+        op.keyon = false;
+        shift_phase(o, l, eg_release);
+    }
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::prepare_operator(unsigned o, unsigned l)
+{
+    Operator &op = op_[o][l];
+    op.param_changed = false;
+
+    // PG Part
+    uint32_t pg_diff = (op.dp + dttable[op.detune + op.bn]) * multable_[op.multiple];
+    pg_diff_[o][l] = pg_diff;
+    pg_diff_lfo_[o][l] = (int32_t)(pg_diff >> 11);
+
+    // EG Part
+    op.key_scale_rate = op.bn >> (3 - op.ks);
+    op.tl_out = op.tl * 8;
+
+    switch (op.eg_phase)
+    {
+    case eg_attack:
+        set_eg_rate(o, l, op.ar ? std::min(63u, op.ar + op.key_scale_rate) : 0);
+        break;
+    case eg_decay:
+        set_eg_rate(o, l, op.dr ? std::min(63u, op.dr + op.key_scale_rate) : 0);
+        op.eg_level_on_next_phase = op.sl * 8;
+        break;
+    case eg_sustain:
+        set_eg_rate(o, l, op.sr ? std::min(63u, op.sr + op.key_scale_rate) : 0);
+        break;
+    case eg_release:
+        set_eg_rate(o, l, std::min(63u, op.rr + op.key_scale_rate));
+        break;
+    default:
+        break;
+    }
+
+    // SSG-EG
+    op.inverted = false;
+    op.held = false;
+    if (op.ssg_type && op.eg_phase != eg_release)
+    {
+        op.inverted = (op.ssg_type & 4) != 0;
+        op.inverted ^= (op.ssg_type & 2) && op.ar != 62;
+    }
+
+    // LFO
+    am_shift_[o][l] = amshifttable[op.amon ? (op.ms >> 4) & 3 : 0];
+    eg_update(o, l);
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::shift_phase(unsigned o, unsigned l, EGPhase next_phase)
+{
+    Operator &op = op_[o][l];
+    switch (next_phase)
+    {
+    case eg_attack:
+        op.tl = op.tl_latch;
+        if ((op.ar + op.key_scale_rate) < 62)
+        {
+            set_eg_rate(o, l, op.ar ? std::min(63u, op.ar + op.key_scale_rate) : 0);
+            op.eg_phase = eg_attack;
+            break;
+        }
+        // fall through
+    case eg_decay:
+        if (op.sl)
+        {
+            op.eg_level = 0;
+            op.eg_level_on_next_phase = op.ssg_type ? std::min(op.sl * 8, 0x200u) : op.sl * 8;
+            set_eg_rate(o, l, op.dr ? std::min(63u, op.dr + op.key_scale_rate) : 0);
+            op.eg_phase = eg_decay;
+            break;
+        }
+        // fall through
+    case eg_sustain:
+        op.eg_level = op.sl * 8;
+        op.eg_level_on_next_phase = op.ssg_type ? 0x200 : 0x400;
+        set_eg_rate(o, l, op.sr ? std::min(63u, op.sr + op.key_scale_rate) : 0);
+        op.eg_phase = eg_sustain;
+        break;
+
+    case eg_release:
+        op.inverted = false;
+        op.held = false;
+        if (op.eg_phase == eg_attack || (op.eg_level < FM_EG_BOTTOM))
+        {
+            op.eg_level_on_next_phase = 0x400;
+            set_eg_rate(o, l, std::min(63u, op.rr + op.key_scale_rate));
+            op.eg_phase = eg_release;
+            break;
+        }
+        // fall through
+    case eg_off:
+    default:
+        op.eg_level = FM_EG_BOTTOM;
+        op.eg_level_on_next_phase = FM_EG_BOTTOM;
+        eg_update(o, l);
+        set_eg_rate(o, l, 0);
+        op.eg_phase = eg_off;
+        break;
+    }
+}
+
+template <unsigned Lanes>
+inline void Bank<Lanes>::set_eg_rate(unsigned o, unsigned l, unsigned rate)
+{
+    op_[o][l].eg_rate = (int)rate;
+    eg_count_diff_[o][l] = decaytable2[rate / 4] * (int32_t)ratio_;
+}
+
+template <unsigned Lanes>
+inline void Bank<Lanes>::eg_update(unsigned o, unsigned l)
+{
+    const Operator &op = op_[o][l];
+    int level = op.eg_level;
+    level = (!op.inverted) ? level : (512 - level) & 0x3ff;
+    eg_out_[o][l] = std::min(op.tl_out + level, 0x3ff) << (1 + 2);
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::eg_calc(unsigned o, unsigned l)
+{
+    Operator &op = op_[o][l];
+    eg_count_[o][l] = (2047 * 3) << FM_RATIOBITS;
+
+    if (op.eg_phase == eg_attack)
+    {
+        int c = attacktable[op.eg_rate][op.eg_curve_count & 7];
+        if (c >= 0)
+        {
+            op.eg_level -= 1 + (op.eg_level >> c);
+            if (op.eg_level <= 0)
+                shift_phase(o, l, eg_decay);
+        }
+        eg_update(o, l);
+    }
+    else if (!op.ssg_type)
+    {
+        op.eg_level += decaytable1[op.eg_rate][op.eg_curve_count & 7];
+        if (op.eg_level >= op.eg_level_on_next_phase)
+            shift_phase(o, l, EGPhase(op.eg_phase + 1));
+        eg_update(o, l);
+    }
+    else
+    {
+        if (!op.held)
+            op.eg_level += 4 * decaytable1[op.eg_rate][op.eg_curve_count & 7];
+        else
+            op.eg_level = (((op.ssg_type & 4) != 0) ^ ((op.ssg_type & 2) != 0)) ? 0 : 1024;
+        eg_update(o, l);
+        if (op.eg_level >= op.eg_level_on_next_phase)
+        {
+            switch (op.eg_phase)
+            {
+            case eg_decay:
+                shift_phase(o, l, eg_sustain);
+                break;
+            case eg_sustain:
+                if (op.ssg_type & 1)
+                {
+                    op.inverted = false;
+                    op.held = true;
+                }
+                if (!op.held)
+                {
+                    op.inverted ^= (op.ssg_type & 2) && (op.ar == 62);
+                    shift_phase(o, l, eg_attack);
+                }
+                break;
+            case eg_release:
+                shift_phase(o, l, eg_off);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    op.eg_curve_count++;
+}
+
+template <unsigned Lanes>
+unsigned Bank<Lanes>::prepare(unsigned enabled, bool *lfo)
+{
+    unsigned active = 0;
+    bool any_lfo = false;
+
+    for (unsigned l = 0; l < Lanes; ++l)
+    {
+        if (!(enabled & (1u << l)))
+            continue;
+
+        bool key = false;
+        bool amon = false;
+        for (unsigned o = 0; o < 4; ++o)
+        {
+            Operator &op = op_[o][l];
+            if (op.param_changed)
+                prepare_operator(o, l);
+            key = key || op.eg_phase != eg_off;
+            amon = amon || op.amon;
+        }
+        pm_row_[l] = (int32_t)((op_[0][l].ms & 7) * FM_LFOENTS);
+
+        if (key)
+            active |= 1u << l;
+        if (op_[0][l].ms & (amon ? 0x37 : 7))
+            any_lfo = true;
+    }
+
+    *lfo = (reg22_ & 0x08) && any_lfo;
+    return active;
+}
+
+template <unsigned Lanes>
+void Bank<Lanes>::mix(int32_t *const output[Lanes], unsigned frames, unsigned enabled)
+{
+    bool lfo;
+    unsigned active = prepare(enabled, &lfo);
+
+    for (unsigned l = 0; l < Lanes; ++l)
+    {
+        if (output[l] && !(active & (1u << l)))
+            std::memset(output[l], 0, frames * sizeof(int32_t));
+    }
+
+    if (!active)
+        return;
+
+    if (lfo)
+        mix_block<true>(output, frames, active);
+    else
+        mix_block<false>(output, frames, active);
+}
+
+template <unsigned Lanes>
+template <bool Lfo, class V>
+inline V Bank<Lanes>::calc_operator(unsigned o, V modulation, V act, V pmv, V am)
+{
+    const Tables &t = tables();
+
+    // phase
+    V pg_count = V::load(pg_count_[o]);
+    V pg_diff = V::load(pg_diff_[o]);
+    if (Lfo)
+        pg_diff = pg_diff + V::mullo(V::load(pg_diff_lfo_[o]), pmv).template sra<5>();
+    (pg_count + (pg_diff & act)).store(pg_count_[o]);
+
+    // level, and output; lanes at rest keep their output
+    V pgin = pg_count.template srl<20 + FM_PGBITS - FM_OPSINBITS>() + modulation;
+    V level = V::load(eg_out_[o]) + V::gather(t.sine, pgin & V::set1(FM_OPSINENTS - 1));
+    if (Lfo)
+        level = level + am.srav(V::load(am_shift_[o])).template sll<3>();
+    V out = V::gather(t.cl, level);
+    blend(act, out, V::load(out_[o])).store(out_[o]);
+    return out;
+}
+
+template <unsigned Lanes>
+template <bool Lfo>
+void Bank<Lanes>::mix_block(int32_t *const output[Lanes], unsigned frames, unsigned active)
+{
+    typedef typename VecFor<Lanes>::type V;
+    const Tables &t = tables();
+
+    int32_t act_mask[Lanes];
+    for (unsigned l = 0; l < Lanes; ++l)
+        act_mask[l] = (active & (1u << l)) ? -1 : 0;
+
+    const V act = V::load(act_mask);
+    const V one = V::set1(1);
+    const V fb_shift = V::load(fb_shift_);
+    const V fb_mask = V::load(fb_mask_);
+
+    for (unsigned i = 0; i < frames; ++i)
+    {
+        // LFO
+        V pmv = V::set1(0);
+        V am = V::set1(0);
+        if (Lfo)
+        {
+            unsigned c = (lfocount_ >> (FM_LFOCBITS + 1)) & 0xff;
+            lfocount_ += lfodcount_;
+            pmv = V::gather(t.pm, V::load(pm_row_) + V::set1((int32_t)c));
+            am = V::set1(t.lfo_am[c] * 4);
+        }
+
+        // envelopes, with the transitions lane by lane
+        for (unsigned o = 0; o < 4; ++o)
+        {
+            V count = V::load(eg_count_[o]) - (V::load(eg_count_diff_[o]) & act);
+            count.store(eg_count_[o]);
+            unsigned due = (V::cmpgt(one, count) & act).bits();
+            for (; due; due &= due - 1)
+                eg_calc(o, lowest_lane(due));
+        }
+
+        // operators in the order of fmgen: 2, 1, 3, then 0 with feedback
+        const V prev0 = V::load(out_[0]);
+        const V prev1 = V::load(out_[1]);
+        const V fb_prev = V::load(fb_out_);
+        V out[4];
+
+        V in2 = (prev0 & V::load(in2_[0])) + (prev1 & V::load(in2_[1]));
+        out[2] = calc_operator<Lfo>(2, in2.template sra<1>(), act, pmv, am);
+        V in1 = prev0 & V::load(in1_);
+        out[1] = calc_operator<Lfo>(1, in1.template sra<1>(), act, pmv, am);
+        V in3 = (prev0 & V::load(in3_[0])) + (out[1] & V::load(in3_[1])) + (out[2] & V::load(in3_[2]));
+        out[3] = calc_operator<Lfo>(3, in3.template sra<1>(), act, pmv, am);
+
+        // self feedback, at most 4 pi
+        V in0 = (prev0 + fb_prev).template sll<1 + IS2EC_SHIFT>().srav(fb_shift);
+        blend(act, prev0, fb_prev).store(fb_out_);
+        out[0] = calc_operator<Lfo>(0, in0.template sra<20 + FM_PGBITS - FM_OPSINBITS>() & fb_mask, act, pmv, am);
+
+        // the carriers; without LFO, the feedback operator gives out its
+        // previous output, like in fmgen
+        V sum = (out[1] & V::load(carrier_[1])) + (out[2] & V::load(carrier_[2])) +
+            (out[3] & V::load(carrier_[3])) + ((Lfo ? out[0] : prev0) & V::load(carrier_[0]));
+
+        int32_t frame[Lanes];
+        (sum & act).store(frame);
+        for (unsigned l = 0; l < Lanes; ++l)
+        {
+            if (output[l])
+                output[l][i] = frame[l];
+        }
+    }
+}
+
+template class Bank<8>;
+template class Bank<16>;
+
+// ---------------------------------------------------------------------------
+//
+uint32_t opna_ratio(uint32_t clock, uint32_t rate, unsigned prescale)
+{
+    static const uint8_t table[3] = { 6, 3, 2 };
+
+    assert(prescale < 3);
+    uint32_t fmclock = clock / 2 / table[prescale] / 12;
+    assert(fmclock < (0x80000000 >> FM_RATIOBITS));
+    return ((fmclock << FM_RATIOBITS) + rate / 2) / rate;
+}
+
+}  // namespace FMLanes
@@ -0,0 +1,130 @@
+// ---------------------------------------------------------------------------
+//	FM Lanes: 4-operator channels computed in lockstep in SIMD lanes
+// ---------------------------------------------------------------------------
+//	The synthesis follows the Operator and Channel4 of fmgen by cisc, with
+//	the same tables, so that a lane sounds like a channel of fmgen OPNA.
+//	Every lane holds an independent patch; lanes share the LFO and the
+//	clock ratio, like the channels of one chip. The state is laid out with
+//	the lanes innermost, the phase, envelope steps and table lookups run
+//	for all the lanes at once, and the rare envelope transitions lane by
+//	lane.
+//
+//	Not emulated: CSM mode, the special mode of channel 3, muting.
+
+#ifndef FM_LANES_H
+#define FM_LANES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace FMLanes
+{
+
+// the natural number of lanes of the instruction set in use
+#if defined(__AVX512F__)
+enum { native_lanes = 16 };
+#else
+enum { native_lanes = 8 };
+#endif
+
+enum EGPhase { eg_next, eg_attack, eg_decay, eg_sustain, eg_release, eg_off };
+
+template <unsigned Lanes>
+class Bank
+{
+public:
+    enum { lanes = Lanes };
+    static_assert(Lanes == 8 || Lanes == 16, "unsupported number of lanes");
+
+    Bank();
+
+    // the ratio of the FM clock to the sample rate, in fixed point with
+    // 7 fractional bits
+    void set_ratio(uint32_t ratio);
+    uint32_t ratio() const { return ratio_; }
+
+    // put every lane in the state of a channel after its reset
+    void reset();
+    void reset_lane(unsigned lane);
+
+    // registers of channel 1, which are addressed to a lane: operators
+    // 0x30-0x9f, F-number 0xa0 with the block, feedback/algorithm 0xb0,
+    // LFO sensitivity 0xb4
+    void set_operator_reg(unsigned lane, unsigned addr, unsigned data);
+    void set_fnum(unsigned lane, unsigned fnum);
+    void set_fb_algorithm(unsigned lane, unsigned data);
+    void set_ms(unsigned lane, unsigned ms);
+    // the 4 key bits of register 0x28, operator 1 in the lowest
+    void key_control(unsigned lane, unsigned key);
+    // the LFO register 0x22, shared by the lanes
+    void set_lfo(unsigned data);
+    unsigned lfo() const { return reg22_; }
+
+    // channel outputs before panning, one buffer per lane; lanes outside
+    // of `enabled`, a mask of lanes, are left as they are and output
+    // nothing. A null output skips the lane.
+    void mix(int32_t *const output[Lanes], unsigned frames, unsigned enabled);
+
+private:
+    struct Operator {
+        uint32_t dp, bn, detune, multiple;
+        int eg_level, eg_level_on_next_phase, eg_rate, eg_curve_count;
+        int tl_out;
+        uint32_t key_scale_rate;
+        EGPhase eg_phase;
+        uint32_t ms, tl, tl_latch, ar, dr, sr, sl, rr, ks, ssg_type;
+        bool keyon, amon, param_changed, inverted, held;
+    };
+
+    template <bool Lfo> void mix_block(int32_t *const output[Lanes], unsigned frames, unsigned active);
+    template <bool Lfo, class V> V calc_operator(unsigned op, V modulation, V active, V pmv, V am);
+    unsigned prepare(unsigned enabled, bool *lfo);
+    void prepare_operator(unsigned op, unsigned lane);
+    void shift_phase(unsigned op, unsigned lane, EGPhase next_phase);
+    void set_eg_rate(unsigned op, unsigned lane, unsigned rate);
+    void eg_update(unsigned op, unsigned lane);
+    void eg_calc(unsigned op, unsigned lane);
+    void key_on(unsigned op, unsigned lane);
+    void key_off(unsigned op, unsigned lane);
+    void reset_operator(unsigned op, unsigned lane);
+
+private:
+    // the state of the lanes, operators in the order of fmgen
+    Operator op_[4][Lanes];
+
+    // the state which is read or written at every sample
+    int32_t out_[4][Lanes];
+    int32_t fb_out_[Lanes];
+    uint32_t pg_count_[4][Lanes];
+    uint32_t pg_diff_[4][Lanes];
+    int32_t pg_diff_lfo_[4][Lanes];
+    int32_t eg_count_[4][Lanes];
+    int32_t eg_count_diff_[4][Lanes];
+    int32_t eg_out_[4][Lanes];
+    int32_t am_shift_[4][Lanes];
+    int32_t pm_row_[Lanes];
+    int32_t fb_shift_[Lanes];
+    int32_t fb_mask_[Lanes];
+    // the routing of the algorithm: masks of the operator outputs into
+    // the inputs of operators 2, 1, 3, in the order of computation, and
+    // into the output
+    int32_t in2_[2][Lanes];
+    int32_t in1_[Lanes];
+    int32_t in3_[3][Lanes];
+    int32_t carrier_[4][Lanes];
+
+    uint32_t ratio_;
+    uint32_t multable_[16];
+    uint32_t lfotable_[8];
+    uint32_t reg22_;
+    uint32_t lfocount_;
+    uint32_t lfodcount_;
+};
+
+// the ratio of the FM clock to the sample rate, for an OPNA clocked at
+// `clock` with the prescaler `prescale` (0-2), rendering at `rate`
+uint32_t opna_ratio(uint32_t clock, uint32_t rate, unsigned prescale);
+
+}  // namespace FMLanes
+
+#endif // FM_LANES_H
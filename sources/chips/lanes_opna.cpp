@@ -0,0 +1,284 @@
+/*
+ * Interfaces over Yamaha OPN2 (YM2612) chip emulators
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "lanes_opna.h"
+#include "lanes/fm_lanes.h"
+#include <cstring>
+
+// libOPNMIDI: soft panning, as in fmgen
+static const uint16_t panlawtable[] =
+{
+    65535, 65529, 65514, 65489, 65454, 65409, 65354, 65289,
+    65214, 65129, 65034, 64929, 64814, 64689, 64554, 64410,
+    64255, 64091, 63917, 63733, 63540, 63336, 63123, 62901,
+    62668, 62426, 62175, 61914, 61644, 61364, 61075, 60776,
+    60468, 60151, 59825, 59489, 59145, 58791, 58428, 58057,
+    57676, 57287, 56889, 56482, 56067, 55643, 55211, 54770,
+    54320, 53863, 53397, 52923, 52441, 51951, 51453, 50947,
+    50433, 49912, 49383, 48846, 48302, 47750, 47191,
+    46340, /* Center left */
+    46340, /* Center right */
+    45472, 44885, 44291, 43690, 43083, 42469, 41848, 41221,
+    40588, 39948, 39303, 38651, 37994, 37330, 36661, 35986,
+    35306, 34621, 33930, 33234, 32533, 31827, 31116, 30400,
+    29680, 28955, 28225, 27492, 26754, 26012, 25266, 24516,
+    23762, 23005, 22244, 21480, 20713, 19942, 19169, 18392,
+    17613, 16831, 16046, 15259, 14469, 13678, 12884, 12088,
+    11291, 10492, 9691, 8888, 8085, 7280, 6473, 5666,
+    4858, 4050, 3240, 2431, 1620, 810, 0
+};
+
+// the whole state, which is copied as it is by the save states
+struct LanesOPNA::Chip
+{
+    FMLanes::Bank<8> bank;
+    uint32_t clock;
+    uint32_t rate;
+    uint32_t prescale;
+    uint32_t fnum[6];
+    uint8_t fnum2[6];
+    uint8_t reg29;
+    uint8_t pan[6];
+    uint16_t panVolumeL[6];
+    uint16_t panVolumeR[6];
+
+    void updateRatio();
+    void setReg(uint32_t addr, uint8_t data);
+    void resetRegs();
+};
+
+void LanesOPNA::Chip::updateRatio()
+{
+    bank.set_ratio(FMLanes::opna_ratio(clock, rate, prescale));
+}
+
+void LanesOPNA::Chip::setReg(uint32_t addr, uint8_t data)
+{
+    unsigned c = addr & 3;
+    switch (addr)
+    {
+    case 0x28:  // Key On/Off
+        if ((data & 3) < 3)
+            bank.key_control((data & 3) + ((data & 4) ? 3 : 0), data >> 4);
+        break;
+
+    case 0x29:
+        reg29 = data;
+        break;
+
+    case 0x2d: case 0x2e: case 0x2f:
+        if (prescale != addr - 0x2d)
+        {
+            prescale = addr - 0x2d;
+            updateRatio();
+        }
+        break;
+
+    case 0x1a0: case 0x1a1: case 0x1a2:
+        c += 3;
+        // fall through
+    case 0xa0: case 0xa1: case 0xa2:
+        fnum[c] = data + fnum2[c] * 0x100;
+        bank.set_fnum(c, fnum[c]);
+        break;
+
+    case 0x1a4: case 0x1a5: case 0x1a6:
+        c += 3;
+        // fall through
+    case 0xa4: case 0xa5: case 0xa6:
+        fnum2[c] = data;
+        break;
+
+    case 0x1b0: case 0x1b1: case 0x1b2:
+        c += 3;
+        // fall through
+    case 0xb0: case 0xb1: case 0xb2:
+        bank.set_fb_algorithm(c, data);
+        break;
+
+    case 0x1b4: case 0x1b5: case 0x1b6:
+        c += 3;
+        // fall through
+    case 0xb4: case 0xb5: case 0xb6:
+        pan[c] = (data >> 6) & 3;
+        bank.set_ms(c, data);
+        break;
+
+    case 0x22:  // LFO
+        bank.set_lfo(data);
+        break;
+
+    default:
+        if (c < 3)
+        {
+            if (addr & 0x100)
+                c += 3;
+            bank.set_operator_reg(c, addr & 0xff, data);
+        }
+        break;
+    }
+}
+
+// the sequence of OPNA::Reset, for the FM part
+void LanesOPNA::Chip::resetRegs()
+{
+    reg29 = 0x1f;
+    if (prescale != 0)
+    {
+        prescale = 0;
+        updateRatio();
+    }
+    for (uint32_t i = 0x20; i < 0x28; i++) setReg(i, 0);
+    for (uint32_t i = 0x30; i < 0xc0; i++) setReg(i, 0);
+    for (uint32_t i = 0x130; i < 0x1c0; i++) setReg(i, 0);
+    for (unsigned i = 0; i < 6; i++)
+    {
+        pan[i] = 3;
+        panVolumeL[i] = panVolumeR[i] = panlawtable[64];
+    }
+    bank.reset();
+}
+
+LanesOPNA::LanesOPNA(OPNFamily f)
+    : ChipBase(f)
+{
+    chip = new Chip;
+    std::memset(chip->fnum, 0, sizeof(chip->fnum));
+    std::memset(chip->fnum2, 0, sizeof(chip->fnum2));
+    chip->prescale = 0;
+    chip->clock = m_clock;
+    chip->rate = m_rate;
+    chip->updateRatio();
+    chip->resetRegs();
+    chip->setReg(0x29, 0x9f);  // enable channels 4-6
+}
+
+LanesOPNA::~LanesOPNA()
+{
+    delete chip;
+}
+
+void LanesOPNA::setRate(uint32_t rate, uint32_t clock)
+{
+    ChipBase::setRate(rate, clock);
+    uint32_t chipRate = isRunningAtPcmRate() ? rate : nativeRate();
+    chip->clock = clock;
+    chip->rate = chipRate;
+    chip->updateRatio();
+    chip->bank.set_lfo(chip->bank.lfo());
+    chip->setReg(0x29, 0x9f);  // enable channels 4-6
+}
+
+void LanesOPNA::reset()
+{
+    ChipBase::reset();
+    chip->resetRegs();
+    chip->setReg(0x29, 0x9f);  // enable channels 4-6
+}
+
+void LanesOPNA::writeReg(uint32_t port, uint16_t addr, uint8_t data)
+{
+    chip->setReg(((port << 8) | addr) & 0x1ff, data);
+}
+
+void LanesOPNA::writePan(uint16_t chan, uint8_t data)
+{
+    chip->panVolumeL[chan] = panlawtable[data & 0x7f];
+    chip->panVolumeR[chan] = panlawtable[0x7f - (data & 0x7f)];
+}
+
+void LanesOPNA::nativeGenerateN(int16_t *output, size_t frames)
+{
+    enum { maxFrames = 256 };
+    int32_t buffers[6][maxFrames];
+    int32_t *channels[8] = {
+        buffers[0], buffers[1], buffers[2], buffers[3], buffers[4], buffers[5], NULL, NULL
+    };
+    unsigned enabled = (chip->reg29 & 0x80) ? 0x3f : 0x07;
+
+    // like FMMix, which sets channel 3 in normal mode at every call
+    chip->bank.set_fnum(2, chip->fnum[2]);
+
+    while (frames > 0)
+    {
+        unsigned count = (frames < maxFrames) ? (unsigned)frames : (unsigned)maxFrames;
+        chip->bank.mix(channels, count, enabled);
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            int lrouts[2] = {0, 0};
+            for (unsigned c = 0; c < 6; ++c)
+            {
+                int out = buffers[c][i];
+                int panl = (chip->pan[c] & 2) ? chip->panVolumeL[c] : 0;
+                int panr = (chip->pan[c] & 1) ? chip->panVolumeR[c] : 0;
+                lrouts[0] += out * panl / 65535;
+                lrouts[1] += out * panr / 65535;
+            }
+            for (unsigned s = 0; s < 2; ++s)
+            {
+                int value = lrouts[s];
+                value = (value > 32767) ? 32767 : (value < -32768) ? -32768 : value;
+                output[2 * i + s] = (int16_t)value;
+            }
+        }
+
+        output += 2 * count;
+        frames -= count;
+    }
+}
+
+void LanesOPNA::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    int32_t *channels[8] = {
+        output[0], output[1], output[2], output[3], output[4], output[5], NULL, NULL
+    };
+    unsigned enabled = (chip->reg29 & 0x80) ? 0x3f : 0x07;
+    chip->bank.mix(channels, (unsigned)frames, enabled);
+
+    // at the level of a centered channel
+    const int panl = panlawtable[64];
+    for (unsigned c = 0; c < 6; ++c)
+    {
+        int32_t *dest = output[c];
+        if (!dest)
+            continue;
+        for (size_t i = 0; i < frames; ++i)
+            dest[i] = dest[i] * panl / 65535;
+    }
+}
+
+size_t LanesOPNA::nativeStateSize() const
+{
+    return sizeof(Chip);
+}
+
+void LanesOPNA::nativeSaveState(void *state) const
+{
+    std::memcpy(state, static_cast<const void *>(chip), sizeof(Chip));
+}
+
+void LanesOPNA::nativeLoadState(const void *state)
+{
+    std::memcpy(static_cast<void *>(chip), state, sizeof(Chip));
+}
+
+const char *LanesOPNA::emulatorName()
+{
+    return "FM Lanes OPNA";  // on the model of fmgen
+}
@@ -0,0 +1,52 @@
+/*
+ * Interfaces over Yamaha OPN2 (YM2612) chip emulators
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef LANES_OPNA_H
+#define LANES_OPNA_H
+
+#include "opn_chip_base.h"
+
+// the FM part of fmgen OPNA, with the 6 channels computed in lockstep in
+// the lanes of a FMLanes::Bank; there is no SSG, ADPCM, rhythm, timer,
+// CSM or channel 3 mode
+class LanesOPNA final : public OPNChipBaseBufferedT<LanesOPNA>
+{
+    typedef OPNChipBaseBufferedT<LanesOPNA> ChipBase;
+    struct Chip;
+    Chip *chip;
+public:
+    explicit LanesOPNA(OPNFamily f);
+    ~LanesOPNA() override;
+
+    bool canRunAtPcmRate() const override { return true; }
+    void setRate(uint32_t rate, uint32_t clock) override;
+    void reset() override;
+    void writeReg(uint32_t port, uint16_t addr, uint8_t data) override;
+    void writePan(uint16_t chan, uint8_t data) override;
+    void nativePreGenerate() override {}
+    void nativePostGenerate() override {}
+    void nativeGenerateN(int16_t *output, size_t frames) override;
+    void nativeGenerateChannels(int32_t *output[6], size_t frames);
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeLoadState(const void *state);
+    const char *emulatorName() override;
+    enum { resamplerPostAttenuate = 2 };
+};
+
+#endif // LANES_OPNA_H
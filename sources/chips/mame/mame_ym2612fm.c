@@ -139,6 +139,7 @@
 #include <stdlib.h>
 #include <string.h>	/* for memset */
 #include <stddef.h>	/* for NULL */
+#include <stdint.h>
 #include <assert.h>
 #include <math.h>
 #include "mamedef.h"
@@ -2194,12 +2195,18 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 }
 
 /* initialize generic tables */
+/* fmprog: the tables are shared by the chips, and built by the first of
+   them; see ym2612_init_tables() for chips initialized in several threads */
+static int tables_ready = 0;
 static void init_tables(void)
 {
 	signed int i,x;
 	signed int n;
 	double o,m;
 
+	if (tables_ready)
+		return;
+
 	/* build Linear Power Table */
 	for (x=0; x<TL_RES_LEN; x++)
 	{
@@ -2295,6 +2302,8 @@ static void init_tables(void)
 #ifdef SAVE_SAMPLE
 	sample[0]=fopen("sampsum.pcm","wb");
 #endif
+
+	tables_ready = 1;
 }
 
 #endif /* BUILD_OPN */
@@ -2395,14 +2404,13 @@ void ym2612_pre_generate(void *chip)
 	refresh_fc_eg_chan( OPN, &cch[5] );
 }
 
-void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[])
+/* compute the channel outputs of the next sample into OPN->out_fm, and advance the chip */
+static void ym2612_step_native(YM2612 *F2612)
 {
-	YM2612 *F2612 = (YM2612 *)chip;
 	FM_OPN *OPN   = &F2612->OPN;
 	INT32  *out_fm = OPN->out_fm;
 	FM_CH  *cch = F2612->CH;
 	INT32 dacout;
-	int lt,rt;
 
 	if (! F2612->MuteDAC)
 		dacout = F2612->dacout;
@@ -2488,6 +2496,51 @@ void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[])
 	if (out_fm[5] > 8192) out_fm[5] = 8192;
 	else if (out_fm[5] < -8192) out_fm[5] = -8192;
 
+	/* CSM mode: if CSM Key ON has occured, CSM Key OFF need to be sent       */
+	/* only if Timer A does not overflow again (i.e CSM Key ON not set again) */
+	OPN->SL3.key_csm <<= 1;
+
+	/* timer A control */
+	/* INTERNAL_TIMER_A( &OPN->ST , cch[2] ) */
+	{
+		if( OPN->ST.TAC &&  (OPN->ST.timer_handler==0) )
+			if( (OPN->ST.TAC -= (int)(OPN->ST.freqbase*4096)) <= 0 )
+			{
+				TimerAOver( &OPN->ST );
+				/* CSM mode total level latch and auto key on */
+				if( OPN->ST.mode & 0x80 )
+					CSMKeyControll( OPN, &cch[2] );
+			}
+	}
+
+	/* CSM Mode Key ON still disabled */
+	if (OPN->SL3.key_csm & 2)
+	{
+		/* CSM Mode Key OFF (verified by Nemesis on real hardware) */
+		FM_KEYOFF_CSM(&cch[2],SLOT1);
+		FM_KEYOFF_CSM(&cch[2],SLOT2);
+		FM_KEYOFF_CSM(&cch[2],SLOT3);
+		FM_KEYOFF_CSM(&cch[2],SLOT4);
+		OPN->SL3.key_csm = 0;
+	}
+}
+
+void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[])
+{
+	YM2612 *F2612 = (YM2612 *)chip;
+	FM_OPN *OPN   = &F2612->OPN;
+	INT32  *out_fm = OPN->out_fm;
+	FM_CH  *cch = F2612->CH;
+	INT32 dacout;
+	int lt,rt;
+
+	if (! F2612->MuteDAC)
+		dacout = F2612->dacout;
+	else
+		dacout = 0;
+
+	ym2612_step_native(F2612);
+
 #define PANLAW_L(ch, chpan) (((out_fm[ch]>>0) * cch[ch].pan_volume_l / 65535) & OPN->pan[chpan]);
 #define PANLAW_R(ch, chpan) (((out_fm[ch]>>0) * cch[ch].pan_volume_r / 65535) & OPN->pan[chpan]);
 
@@ -2533,33 +2586,24 @@ void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[])
 
 	buffer[0] = (FMSAMPLE)(F2612->WaveL / 2);
 	buffer[1] = (FMSAMPLE)(F2612->WaveR / 2);
+}
 
-	/* CSM mode: if CSM Key ON has occured, CSM Key OFF need to be sent       */
-	/* only if Timer A does not overflow again (i.e CSM Key ON not set again) */
-	OPN->SL3.key_csm <<= 1;
+void ym2612_generate_channels_native(void *chip, INT32 *buffers[6], int frames)
+{
+	YM2612 *F2612 = (YM2612 *)chip;
+	INT32  *out_fm = F2612->OPN.out_fm;
+	int i, c;
 
-	/* timer A control */
-	/* INTERNAL_TIMER_A( &OPN->ST , cch[2] ) */
+	for (i = 0; i < frames; i++)
 	{
-		if( OPN->ST.TAC &&  (OPN->ST.timer_handler==0) )
-			if( (OPN->ST.TAC -= (int)(OPN->ST.freqbase*4096)) <= 0 )
-			{
-				TimerAOver( &OPN->ST );
-				/* CSM mode total level latch and auto key on */
-				if( OPN->ST.mode & 0x80 )
-					CSMKeyControll( OPN, &cch[2] );
-			}
-	}
+		ym2612_step_native(F2612);
 
-	/* CSM Mode Key ON still disabled */
-	if (OPN->SL3.key_csm & 2)
-	{
-		/* CSM Mode Key OFF (verified by Nemesis on real hardware) */
-		FM_KEYOFF_CSM(&cch[2],SLOT1);
-		FM_KEYOFF_CSM(&cch[2],SLOT2);
-		FM_KEYOFF_CSM(&cch[2],SLOT3);
-		FM_KEYOFF_CSM(&cch[2],SLOT4);
-		OPN->SL3.key_csm = 0;
+		/* at the level of a centered channel in the stereo output */
+		for (c = 0; c < 6; c++)
+		{
+			if (buffers[c])
+				buffers[c][i] = out_fm[c] * panlawtable[64] / 65535 / 2;
+		}
 	}
 }
 
@@ -2617,6 +2661,12 @@ static void YM2612_save_state(YM2612 *F2612, running_device *device)
 }
 #endif /* _STATE_H */
 
+/* build the shared tables ahead of ym2612_init() */
+void ym2612_init_tables(void)
+{
+	init_tables();
+}
+
 /* initialize YM2612 emulator(s) */
 /* void * ym2612_init(void *param, running_device *device, int clock, int rate,
 						FM_TIMERHANDLER timer_handler,FM_IRQHANDLER IRQHandler) */
@@ -2758,6 +2808,63 @@ void ym2612_reset_chip(void *chip)
 		F2612->WaveOutMode >>= 1;
 }
 
+/* fmprog: state snapshots */
+typedef struct
+{
+	const void *base;	/* address of the chip which saved the state */
+	YM2612 chip;
+} YM2612_STATE;
+
+/* moves a pointer into the chip `from`, to the same place in the chip `to` */
+static void *state_relocate(const void *p, const void *from, void *to)
+{
+	uintptr_t offset = (uintptr_t)p - (uintptr_t)from;
+	if (offset >= sizeof(YM2612))
+		return (void *)p;
+	return (UINT8 *)to + offset;
+}
+
+size_t ym2612_state_size(void)
+{
+	return sizeof(YM2612_STATE);
+}
+
+void ym2612_save_state(void *chip, void *state)
+{
+	YM2612_STATE *st = (YM2612_STATE *)state;
+	st->base = chip;
+	memcpy(&st->chip, chip, sizeof(YM2612));
+}
+
+void ym2612_load_state(void *chip, const void *state)
+{
+	const YM2612_STATE *st = (const YM2612_STATE *)state;
+	YM2612 *F2612 = (YM2612 *)chip;
+	FM_ST saved_st = F2612->OPN.ST;
+	int c, s;
+
+	memcpy(F2612, &st->chip, sizeof(YM2612));
+
+	/* the host interface stays the one of this chip */
+	F2612->OPN.ST.param = saved_st.param;
+	F2612->OPN.ST.timer_handler = saved_st.timer_handler;
+	F2612->OPN.ST.IRQ_Handler = saved_st.IRQ_Handler;
+	F2612->OPN.ST.SSG = saved_st.SSG;
+
+	F2612->OPN.P_CH = (FM_CH *)state_relocate(F2612->OPN.P_CH, st->base, F2612);
+	for (c = 0; c < 6; c++)
+	{
+		FM_CH *CH = &F2612->CH[c];
+		CH->connect1 = (INT32 *)state_relocate(CH->connect1, st->base, F2612);
+		CH->connect2 = (INT32 *)state_relocate(CH->connect2, st->base, F2612);
+		CH->connect3 = (INT32 *)state_relocate(CH->connect3, st->base, F2612);
+		CH->connect4 = (INT32 *)state_relocate(CH->connect4, st->base, F2612);
+		CH->mem_connect = (INT32 *)state_relocate(CH->mem_connect, st->base, F2612);
+		for (s = 0; s < 4; s++)
+			CH->SLOT[s].DT = (INT32 *)state_relocate(CH->SLOT[s].DT, st->base, F2612);
+	}
+}
+
 /* YM2612 write */
 /* n = number  */
 /* a = address */
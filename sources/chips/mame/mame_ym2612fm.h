@@ -7,6 +7,7 @@
 #define FM_HHHHH
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -103,6 +104,12 @@ typedef void (*FM_IRQHANDLER)(void *param,int irq);
 
 #if (BUILD_YM2612||BUILD_YM3438)
 
+/**
+ * @brief Build the tables shared by all the chips, which ym2612_init() does
+ *        otherwise the first time; call it once, before initializing chips
+ *        from several threads at once
+ */
+void ym2612_init_tables(void);
 /**
  * @brief Initialize chip and return the instance
  * @param param Unused, keep NULL
@@ -124,6 +131,23 @@ void ym2612_shutdown(void *chip);
  * @param chip Chip instance
  */
 void ym2612_reset_chip(void *chip);
+
+/**
+ * @brief Size of the chip state, as saved by ym2612_save_state()
+ */
+size_t ym2612_state_size(void);
+/**
+ * @brief Save the state of the chip
+ * @param chip Chip instance
+ * @param state Memory of ym2612_state_size() bytes, aligned for any type
+ */
+void ym2612_save_state(void *chip, void *state);
+/**
+ * @brief Restore a state into a chip which has the same clock and rate as the one it was saved from
+ * @param chip Chip instance
+ * @param state State saved by ym2612_save_state()
+ */
+void ym2612_load_state(void *chip, const void *state);
 /**
  * @brief Generate stereo output of specified length
  * @param chip Chip instance
@@ -145,6 +169,14 @@ void ym2612_pre_generate(void *chip);
  * @param buffer One stereo PCM frame
  */
 void ym2612_generate_one_native(void *chip, FMSAMPLE buffer[2]);
+/**
+ * @brief Generate the output of each channel apart, without panning, at the level of a
+ *        centered channel in the stereo output. Will be used native sample rate of 53267 Hz
+ * @param chip Chip instance
+ * @param buffers One buffer per channel, NULL to skip a channel
+ * @param frames Output buffer size in frames
+ */
+void ym2612_generate_channels_native(void *chip, INT32 *buffers[6], int frames);
 
 /* void ym2612_post_generate(void *chip, int length); */
 
@@ -21,11 +21,16 @@
 #include "mame_opn2.h"
 #include "mame/mame_ym2612fm.h"
 #include <cstdlib>
+#include <mutex>
 #include <assert.h>
 
+// the emulator tables are shared, and chips can be made by several threads
+static std::once_flag tables;
+
 MameOPN2::MameOPN2(OPNFamily f)
     : OPNChipBaseT(f)
 {
+    std::call_once(tables, ym2612_init_tables);
     chip = NULL;
     setRate(m_rate, m_clock);
 }
@@ -74,6 +79,27 @@ void MameOPN2::nativeGenerate(int16_t *frame)
     ym2612_generate_one_native(chip, frame);
 }
 
+void MameOPN2::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    void *chip = this->chip;
+    ym2612_generate_channels_native(chip, output, static_cast<int>(frames));
+}
+
+size_t MameOPN2::nativeStateSize() const
+{
+    return ym2612_state_size();
+}
+
+void MameOPN2::nativeSaveState(void *state) const
+{
+    ym2612_save_state(chip, state);
+}
+
+void MameOPN2::nativeLoadState(const void *state)
+{
+    ym2612_load_state(chip, state);
+}
+
 const char *MameOPN2::emulatorName()
 {
     return "MAME YM2612";
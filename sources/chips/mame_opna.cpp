@@ -166,6 +166,31 @@ void MameOPNA::nativeGenerateN(int16_t *output, size_t frames)
     }
 }
 
+void MameOPNA::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    void *chip = impl->chip;
+    ym2608_update_channels(chip, output, (int)frames);
+}
+
+size_t MameOPNA::nativeStateSize() const
+{
+    return alignStateSize(ym2608_state_size()) + sizeof(PSG);
+}
+
+void MameOPNA::nativeSaveState(void *state) const
+{
+    ym2608_save_state(impl->chip, state);
+    void *psgState = static_cast<uint8_t *>(state) + alignStateSize(ym2608_state_size());
+    std::memcpy(psgState, &impl->dev.m_psg, sizeof(PSG));
+}
+
+void MameOPNA::nativeLoadState(const void *state)
+{
+    ym2608_load_state(impl->chip, state);
+    const void *psgState = static_cast<const uint8_t *>(state) + alignStateSize(ym2608_state_size());
+    std::memcpy(&impl->dev.m_psg, psgState, sizeof(PSG));
+}
+
 const char *MameOPNA::emulatorName()
 {
     return "MAME YM2608";  // git 2018-12-15 rev 8ab05c0
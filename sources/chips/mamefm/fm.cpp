@@ -115,6 +115,7 @@
 /************************************************************************/
 
 #include "emu.h"
+#include <mutex>
 
 #define YM2610B_WARNING
 #include "fm.h"
@@ -203,12 +204,12 @@
 *   TL_RES_LEN - sinus resolution (X axis)
 */
 #define TL_TAB_LEN (13*2*TL_RES_LEN)
-static signed int tl_tab[TL_TAB_LEN];
+alignas(64) static signed int tl_tab[TL_TAB_LEN];
 
 #define ENV_QUIET       (TL_TAB_LEN>>3)
 
 /* sin waveform table in 'decibel' scale */
-static unsigned int sin_tab[SIN_LEN];
+alignas(64) static unsigned int sin_tab[SIN_LEN];
 
 /* sustain level table (3dB per step) */
 /* bit0, bit1, bit2, bit3, bit4, bit5, bit6 */
@@ -490,7 +491,7 @@ static const uint8_t lfo_pm_output[7*8][8]={ /* 7 bits meaningful (of F-NUMBER),
 };
 
 /* all 128 LFO PM waveforms */
-static int32_t lfo_pm_table[128*8*32]; /* 128 combinations of 7 bits meaningful (of F-NUMBER), 8 LFO depths, 32 LFO output levels per one depth */
+alignas(64) static int32_t lfo_pm_table[128*8*32]; /* 128 combinations of 7 bits meaningful (of F-NUMBER), 8 LFO depths, 32 LFO output levels per one depth */
 
 
 // libOPNMIDI: pan law table
@@ -1560,8 +1561,15 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 	for( c = 0 ; c < num ; c++ )
 	{
 		CH[c].fc = 0;
+		/* fmprog: clear the state which would otherwise leak into the next note */
+		CH[c].mem_value = 0;
+		CH[c].op1_out[0] = 0;
+		CH[c].op1_out[1] = 0;
 		for(s = 0 ; s < 4 ; s++ )
 		{
+			CH[c].SLOT[s].key = 0;
+			CH[c].SLOT[s].phase = 0;
+			CH[c].SLOT[s].Incr = -1;
 			CH[c].SLOT[s].ssg = 0;
 			CH[c].SLOT[s].ssgn = 0;
 			CH[c].SLOT[s].state= EG_OFF;
@@ -1571,8 +1579,8 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 	}
 }
 
-/* initialize generic tables */
-static int init_tables(void)
+/* build generic tables */
+static void build_tables(void)
 {
 	signed int i,x;
 	signed int n;
@@ -1682,9 +1690,16 @@ static int init_tables(void)
 #ifdef SAVE_SAMPLE
 	sample[0]=fopen("sampsum.pcm","wb");
 #endif
+}
 
+/* initialize generic tables */
+/* fmprog: the tables are shared by the chips, which can be initialized by
+   several threads at once; they are built once, and only read afterwards */
+static int init_tables(void)
+{
+	static std::once_flag once;
+	std::call_once(once, build_tables);
 	return 1;
-
 }
 
 
@@ -2450,7 +2465,7 @@ CONSTEXPR unsigned ADPCM_SHIFT          = 16;  /* frequency step rate   */
 CONSTEXPR unsigned ADPCMA_ADDRESS_SHIFT = 8;   /* adpcm A address shift */
 
 /* speedup purposes only */
-static int jedi_table[ 49*16 ];
+alignas(64) static int jedi_table[ 49*16 ];
 
 /* ADPCM type A channel struct */
 struct ADPCM_CH
@@ -2681,7 +2696,7 @@ CONSTEXPR int steps[49] =
 };
 
 
-void Init_ADPCMATable()
+static void build_ADPCMATable()
 {
 	int step, nib;
 
@@ -2696,6 +2711,12 @@ void Init_ADPCMATable()
 	}
 }
 
+void Init_ADPCMATable()
+{
+	static std::once_flag once;
+	std::call_once(once, build_ADPCMATable);
+}
+
 #ifdef MAME_EMU_SAVE_H
 /* FM channel save , internal state only */
 void FMsave_state_adpcma(device_t *device,ADPCM_CH *adpcm)
@@ -2767,19 +2788,23 @@ static inline void YM2608IRQMaskWrite(FM_OPN *OPN, ym2608_state *F2608, int v)
 }
 
 /* Generate samples for one of the YM2608s */
-void ym2608_update_one(void *chip, FMSAMPLE **buffer, int length)
+/* fmprog: output either the stereo mix into `buffer`, or the FM channels
+   apart into `channels` */
+static void ym2608_update(ym2608_state *F2608, FMSAMPLE **buffer, int32_t **channels, int length)
 {
-	ym2608_state *F2608 = (ym2608_state *)chip;
 	FM_OPN *OPN   = &F2608->OPN;
 	YM_DELTAT *DELTAT = &F2608->deltaT;
 	int i,j;
-	FMSAMPLE  *bufL,*bufR;
+	FMSAMPLE  *bufL = NULL,*bufR = NULL;
 	FM_CH   *cch[6];
 	int32_t *out_fm = OPN->out_fm;
 
 	/* set bufer */
-	bufL = buffer[0];
-	bufR = buffer[1];
+	if (buffer)
+	{
+		bufL = buffer[0];
+		bufR = buffer[1];
+	}
 
 	cch[0]   = &F2608->CH[0];
 	cch[1]   = &F2608->CH[1];
@@ -2860,6 +2885,16 @@ void ym2608_update_one(void *chip, FMSAMPLE **buffer, int length)
 		}
 
 		/* buffering */
+		if (channels)
+		{
+			/* at the level of a centered channel in the stereo output */
+			for( j = 0; j < 6; j++ )
+			{
+				if( channels[j] )
+					channels[j][i] = ((out_fm[j]>>1) * 46340 / 65535) >> FINAL_SH;
+			}
+		}
+		else
 		{
 			int lt,rt;
 
@@ -2911,6 +2946,16 @@ void ym2608_update_one(void *chip, FMSAMPLE **buffer, int length)
 	FM_STATUS_SET(&OPN->ST, 0);
 
 }
+
+void ym2608_update_one(void *chip, FMSAMPLE **buffer, int length)
+{
+	ym2608_update((ym2608_state *)chip, buffer, NULL, length);
+}
+
+void ym2608_update_channels(void *chip, int32_t **channels, int length)
+{
+	ym2608_update((ym2608_state *)chip, NULL, channels, length);
+}
 #ifdef MAME_EMU_SAVE_H
 void ym2608_postload(void *chip)
 {
@@ -3054,6 +3099,68 @@ void ym2608_clock_changed(void *chip, int clock, int rate)
 	F2608->OPN.ST.rate = rate;
 }
 
+/* fmprog: state snapshots */
+struct ym2608_saved_state
+{
+	const void *base;   /* address of the chip which saved the state */
+	ym2608_state chip;
+};
+
+/* moves a pointer into the chip `from`, to the same place in the chip `to` */
+template <class T>
+static T *state_relocate(T *p, const void *from, void *to)
+{
+	uintptr_t offset = (uintptr_t)p - (uintptr_t)from;
+	if (offset >= sizeof(ym2608_state))
+		return p;
+	return (T *)((uint8_t *)to + offset);
+}
+
+size_t ym2608_state_size()
+{
+	return sizeof(ym2608_saved_state);
+}
+
+void ym2608_save_state(void *chip, void *state)
+{
+	ym2608_saved_state *st = (ym2608_saved_state *)state;
+	st->base = chip;
+	memcpy(&st->chip, chip, sizeof(ym2608_state));
+}
+
+void ym2608_load_state(void *chip, const void *state)
+{
+	const ym2608_saved_state *st = (const ym2608_saved_state *)state;
+	ym2608_state *F2608 = (ym2608_state *)chip;
+	device_t *device = F2608->device;
+
+	memcpy(F2608, &st->chip, sizeof(ym2608_state));
+
+	/* the host device stays the one of this chip */
+	F2608->device = device;
+	F2608->OPN.ST.device = device;
+	F2608->deltaT.device = device;
+
+	F2608->OPN.P_CH = state_relocate(F2608->OPN.P_CH, st->base, F2608);
+	for (int c = 0; c < 6; c++)
+	{
+		FM_CH *CH = &F2608->CH[c];
+		CH->connect1 = state_relocate(CH->connect1, st->base, F2608);
+		CH->connect2 = state_relocate(CH->connect2, st->base, F2608);
+		CH->connect3 = state_relocate(CH->connect3, st->base, F2608);
+		CH->connect4 = state_relocate(CH->connect4, st->base, F2608);
+		CH->mem_connect = state_relocate(CH->mem_connect, st->base, F2608);
+		for (int s = 0; s < 4; s++)
+			CH->SLOT[s].DT = state_relocate(CH->SLOT[s].DT, st->base, F2608);
+		F2608->adpcm[c].pan = state_relocate(F2608->adpcm[c].pan, st->base, F2608);
+	}
+
+	YM_DELTAT *DELTAT = &F2608->deltaT;
+	DELTAT->output_pointer = state_relocate(DELTAT->output_pointer, st->base, F2608);
+	DELTAT->pan = state_relocate(DELTAT->pan, st->base, F2608);
+	DELTAT->status_change_which_chip = state_relocate(DELTAT->status_change_which_chip, st->base, F2608);
+}
+
 /* shut down emulator */
 void ym2608_shutdown(void *chip)
 {
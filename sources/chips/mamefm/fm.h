@@ -146,7 +146,12 @@ void * ym2608_init(device_t *device, int baseclock, int rate,
 void ym2608_clock_changed(void *chip, int clock, int rate);
 void ym2608_shutdown(void *chip);
 void ym2608_reset_chip(void *chip);
+/* fmprog: the state can be loaded in a chip of the same configuration */
+size_t ym2608_state_size();
+void ym2608_save_state(void *chip, void *state);
+void ym2608_load_state(void *chip, const void *state);
 void ym2608_update_one(void *chip, FMSAMPLE **buffer, int length);
+void ym2608_update_channels(void *chip, int32_t **channels, int length);  // fmprog: FM channels apart, NULL skips
 
 int ym2608_write(void *chip, int a,unsigned char v);
 void ym2608_write_pan(void *chip, int c,unsigned char v);  // libOPNMIDI: soft panning
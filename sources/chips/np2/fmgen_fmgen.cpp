@@ -169,10 +169,8 @@ namespace FM
 #endif
 
 	// fixed equasion-based tables
-	int		pmtable[2][8][FM_LFOENTS];
-	uint	amtable[2][4][FM_LFOENTS];
-
-	static bool tablemade = false;
+	alignas(64) int		pmtable[2][8][FM_LFOENTS];
+	alignas(64) uint	amtable[2][4][FM_LFOENTS];
 }
 
 namespace FM
@@ -183,11 +181,6 @@ namespace FM
 //
 void MakeLFOTable()
 {
-	if (tablemade)
-		return;
-
-	tablemade = true;
-
 	int i;
 
 	static const double pms[2][8] =
@@ -294,16 +287,17 @@ void Chip::DataLoad(struct ChipData* data)
 // ---------------------------------------------------------------------------
 //	Operator
 //
-bool FM::Operator::tablehasmade = false;
-uint FM::Operator::sinetable[1024];
-int32 FM::Operator::cltable[FM_CLENTS];
+// fmprog: the tables are shared by all the chips, which can be constructed
+// by several threads at once; they are made once, and only read afterwards
+static std::once_flag operator_tables;
+alignas(64) uint FM::Operator::sinetable[1024];
+alignas(64) int32 FM::Operator::cltable[FM_CLENTS];
 
 //	構築
 FM::Operator::Operator()
 : chip_(0)
 {
-	if (!tablehasmade)
-		MakeTable();
+	std::call_once(operator_tables, MakeTable);
 
 	// EG Part
 	ar_ = dr_ = sr_ = rr_ = key_scale_rate_ = 0;
@@ -333,6 +327,12 @@ void FM::Operator::Reset()
 {
 	// EG part
 	tl_ = tl_latch_ = 127;
+	// fmprog: restore the state left by the constructor, otherwise a key
+	// left on would ignore the next KeyOn, and the next attack would use
+	// the key scale of the previous note
+	keyon_ = false;
+	key_scale_rate_ = 0;
+	tl_out_ = 0;
 	ShiftPhase(off);
 	eg_count_ = 0;
 	eg_curve_count_ = 0;
@@ -390,8 +390,6 @@ void Operator::MakeTable()
 	}
 
 	::FM::MakeLFOTable();
-
-	tablehasmade = true;
 }
 
 
@@ -863,21 +861,46 @@ inline FM::ISample FM::Operator::CalcFBL(uint fb)
 	return out_;
 }
 
+//	fmprog: CalcFB/CalcFBL with the test of the feedback done at compile time
+template <bool lfo, bool feedback>
+inline FM::ISample FM::Operator::CalcFBT(uint fb)
+{
+	EGStep();
+
+	ISample in = out_ + out2_;
+	out2_ = out_;
+
+	int pgin = (lfo ? PGCalcL() : PGCalc()) >> (20+FM_PGBITS-FM_OPSINBITS);
+	if (feedback)
+	{
+		pgin += ((in << (1 + IS2EC_SHIFT)) >> fb) >> (20+FM_PGBITS-FM_OPSINBITS);
+	}
+
+	if (lfo)
+	{
+		out_ = LogToLin(eg_out_ + SINE(pgin) + ams_[chip_->GetAML()]);
+		dbgopout_ = out_;
+		return out_;
+	}
+	out_ = LogToLin(eg_out_ + SINE(pgin));
+	dbgopout_ = out2_;
+	return out2_;
+}
+
 #undef Sine
 
 // ---------------------------------------------------------------------------
 //	4-op Channel
 //
 const uint8 Channel4::fbtable[8] = { 31, 7, 6, 5, 4, 3, 2, 1 };
-int Channel4::kftable[64];
+alignas(64) int Channel4::kftable[64];
 
-bool Channel4::tablehasmade = false;
+static std::once_flag channel4_tables;
 
 
 Channel4::Channel4()
 {
-	if (!tablehasmade)
-		MakeTable();
+	std::call_once(channel4_tables, MakeTable);
 
 	SetAlgorithm(0);
 	pms = pmtable[0][0];
@@ -1134,6 +1157,94 @@ ISample Channel4::CalcLN(uint noise)
 	return *out[2] + o;
 }
 
+//  fmprog: a block of samples, with the algorithm, the LFO and the
+//  feedback resolved at compile time
+template <int algo, bool lfo, bool feedback>
+void Channel4::CalcBlockT(ISample* dest, int nsamples, const uint8* pml, const uint8* aml)
+{
+	for (int i = 0; i < nsamples; i++)
+	{
+		if (lfo)
+		{
+			chip_->SetPML(pml[i]);
+			chip_->SetAML(aml[i]);
+			chip_->SetPMV(pms[chip_->GetPML()]);
+		}
+
+		int r;
+		switch (algo)
+		{
+		case 0:
+			lfo ? op[2].CalcL(op[1].Out()) : op[2].Calc(op[1].Out());
+			lfo ? op[1].CalcL(op[0].Out()) : op[1].Calc(op[0].Out());
+			r = lfo ? op[3].CalcL(op[2].Out()) : op[3].Calc(op[2].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 1:
+			lfo ? op[2].CalcL(op[0].Out() + op[1].Out()) : op[2].Calc(op[0].Out() + op[1].Out());
+			lfo ? op[1].CalcL(0) : op[1].Calc(0);
+			r = lfo ? op[3].CalcL(op[2].Out()) : op[3].Calc(op[2].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 2:
+			lfo ? op[2].CalcL(op[1].Out()) : op[2].Calc(op[1].Out());
+			lfo ? op[1].CalcL(0) : op[1].Calc(0);
+			r = lfo ? op[3].CalcL(op[0].Out() + op[2].Out()) : op[3].Calc(op[0].Out() + op[2].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 3:
+			lfo ? op[2].CalcL(0) : op[2].Calc(0);
+			lfo ? op[1].CalcL(op[0].Out()) : op[1].Calc(op[0].Out());
+			r = lfo ? op[3].CalcL(op[1].Out() + op[2].Out()) : op[3].Calc(op[1].Out() + op[2].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 4:
+			lfo ? op[2].CalcL(0) : op[2].Calc(0);
+			r = lfo ? op[1].CalcL(op[0].Out()) : op[1].Calc(op[0].Out());
+			r += lfo ? op[3].CalcL(op[2].Out()) : op[3].Calc(op[2].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 5:
+			r =  lfo ? op[2].CalcL(op[0].Out()) : op[2].Calc(op[0].Out());
+			r += lfo ? op[1].CalcL(op[0].Out()) : op[1].Calc(op[0].Out());
+			r += lfo ? op[3].CalcL(op[0].Out()) : op[3].Calc(op[0].Out());
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		case 6:
+			r  = lfo ? op[2].CalcL(0) : op[2].Calc(0);
+			r += lfo ? op[1].CalcL(op[0].Out()) : op[1].Calc(op[0].Out());
+			r += lfo ? op[3].CalcL(0) : op[3].Calc(0);
+			op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		default:
+			r  = lfo ? op[2].CalcL(0) : op[2].Calc(0);
+			r += lfo ? op[1].CalcL(0) : op[1].Calc(0);
+			r += lfo ? op[3].CalcL(0) : op[3].Calc(0);
+			r += op[0].CalcFBT<lfo, feedback>(fb);
+			break;
+		}
+		dest[i] = r;
+	}
+}
+
+//  fmprog: a block of samples; the kernel is chosen once per block
+void Channel4::CalcBlock(ISample* dest, int nsamples, const uint8* pml, const uint8* aml)
+{
+	typedef void (Channel4::*Kernel)(ISample*, int, const uint8*, const uint8*);
+#define KERNELS(a) \
+	{ { &Channel4::CalcBlockT<a, false, false>, &Channel4::CalcBlockT<a, false, true> }, \
+	  { &Channel4::CalcBlockT<a, true, false>, &Channel4::CalcBlockT<a, true, true> } }
+	static const Kernel kernels[8][2][2] =
+	{
+		KERNELS(0), KERNELS(1), KERNELS(2), KERNELS(3),
+		KERNELS(4), KERNELS(5), KERNELS(6), KERNELS(7),
+	};
+#undef KERNELS
+
+	assert(0 <= algo_ && algo_ < 8);
+	(this->*kernels[algo_][pml != 0][fb < 31])(dest, nsamples, pml, aml);
+}
+
 void Channel4::DataSave(struct Channel4Data* data) {
 	data->fb = fb;
 	memcpy(data->buf, buf, sizeof(int) * 4);
@@ -108,6 +108,8 @@ namespace FM
 		ISample	CalcL(ISample in);
 		ISample CalcFB(uint fb);
 		ISample CalcFBL(uint fb);
+		// fmprog: CalcFB or CalcFBL, for a feedback known to be on or off
+		template <bool lfo, bool feedback> ISample CalcFBT(uint fb);
 		ISample CalcN(uint noise);
 		void	Prepare();
 		void	KeyOn();
@@ -229,7 +231,6 @@ namespace FM
 		static uint	sinetable[1024];
 		static int32 cltable[FM_CLENTS];
 
-		static bool tablehasmade;
 		static void MakeTable();
 
 
@@ -263,6 +264,9 @@ namespace FM
 		ISample CalcL();
 		ISample CalcN(uint noise);
 		ISample CalcLN(uint noise);
+		// fmprog: a block of samples, like Calc, or like CalcL with the LFO
+		// levels of each sample given in pml and aml
+		void CalcBlock(ISample* dest, int nsamples, const uint8* pml, const uint8* aml);
 		void SetFNum(uint fnum);
 		void SetFB(uint fb);
 		void SetKCKF(uint kc, uint kf);
@@ -291,7 +295,9 @@ namespace FM
 
 		static void MakeTable();
 
-		static bool tablehasmade;
+		template <int algo, bool lfo, bool feedback>
+		void CalcBlockT(ISample* dest, int nsamples, const uint8* pml, const uint8* aml);
+
 		static int 	kftable[64];
 
 
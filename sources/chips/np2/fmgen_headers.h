@@ -6,5 +6,6 @@
 #include <math.h>
 #include <string.h>
 #include <assert.h>
+#include <mutex>
 
 #endif	// WIN_HEADERS_H
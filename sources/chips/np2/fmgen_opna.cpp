@@ -38,7 +38,6 @@ namespace FM
 
 #if defined(BUILD_OPN) || defined(BUILD_OPNA) || defined (BUILD_OPNB)
 
-uint32	OPNBase::lfotable[8];			// OPNA/B �p
 
 OPNBase::OPNBase()
 {
@@ -428,11 +427,12 @@ void OPN::Mix(Sample* buffer, int nsamples)
 
 #if defined(BUILD_OPNA) || defined(BUILD_OPNB)
 
-int OPNABase::amtable[FM_LFOENTS] = { -1, };
-int OPNABase::pmtable[FM_LFOENTS];
+// fmprog: made once for all the chips, like the tables of Operator
+static std::once_flag opnabase_tables;
+alignas(64) int OPNABase::amtable[FM_LFOENTS];
+alignas(64) int OPNABase::pmtable[FM_LFOENTS];
 
-int32 OPNABase::tltable[FM_TLENTS+FM_TLPOS];
-bool OPNABase::tablehasmade = false;
+alignas(64) int32 OPNABase::tltable[FM_TLENTS+FM_TLPOS];
 
 OPNABase::OPNABase()
 {
@@ -444,8 +444,7 @@ OPNABase::OPNABase()
 	adpcmvol = 0;
 	control2 = 0;
 
-	MakeTable2();
-	BuildLFOTable();
+	std::call_once(opnabase_tables, MakeTable2);
 	for (int i=0; i<6; i++)
 	{
 		ch[i].SetChip(&chip);
@@ -477,15 +476,12 @@ bool OPNABase::Init(uint, uint, bool)
 //
 void OPNABase::MakeTable2()
 {
-	if (!tablehasmade)
+	for (int i=-FM_TLPOS; i<FM_TLENTS; i++)
 	{
-		for (int i=-FM_TLPOS; i<FM_TLENTS; i++)
-		{
-			tltable[i+FM_TLPOS] = uint(65536. * pow(2.0, i * -16. / FM_TLENTS))-1;
-		}
-
-		tablehasmade = true;
+		tltable[i+FM_TLPOS] = uint(65536. * pow(2.0, i * -16. / FM_TLENTS))-1;
 	}
+
+	BuildLFOTable();
 }
 
 // libOPNMIDI: soft panning
@@ -1292,34 +1288,33 @@ inline void OPNABase::MixSubS(int activech, ISample** dest)
 
 void OPNABase::BuildLFOTable()
 {
-	if (amtable[0] == -1)
+	for (int c=0; c<256; c++)
 	{
-		for (int c=0; c<256; c++)
-		{
-			int v;
-			if (c < 0x40)		v = c * 2 + 0x80;
-			else if (c < 0xc0)	v = 0x7f - (c - 0x40) * 2 + 0x80;
-			else				v = (c - 0xc0) * 2;
-			pmtable[c] = c;
-
-			if (c < 0x80)		v = 0xff - c * 2;
-			else				v = (c - 0x80) * 2;
-			amtable[c] = v & ~3;
-		}
+		int v;
+		if (c < 0x40)		v = c * 2 + 0x80;
+		else if (c < 0xc0)	v = 0x7f - (c - 0x40) * 2 + 0x80;
+		else				v = (c - 0xc0) * 2;
+		pmtable[c] = c;
+
+		if (c < 0x80)		v = 0xff - c * 2;
+		else				v = (c - 0x80) * 2;
+		amtable[c] = v & ~3;
 	}
 }
 
 // ---------------------------------------------------------------------------
 
-inline void OPNABase::LFO()
-{
-//	LOG3("%4d - %8d, %8d\n", c, lfocount, lfodcount);
+#define FM_MIXBLOCK		256			// fmprog: samples mixed at once, per channel
 
-//	Operator::SetPML(pmtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
-//	Operator::SetAML(amtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
-	chip.SetPML(pmtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
-	chip.SetAML(amtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
-	lfocount += lfodcount;
+//	fmprog: the LFO levels of a block of samples, for Channel4::CalcBlock
+inline void OPNABase::LFOBlock(uint8* pml, uint8* aml, int nsamples)
+{
+	for (int i = 0; i < nsamples; ++i)
+	{
+		pml[i] = uint8(pmtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
+		aml[i] = uint8(amtable[(lfocount >> (FM_LFOCBITS+1)) & 0xff]);
+		lfocount += lfodcount;
+	}
 }
 
 // ---------------------------------------------------------------------------
@@ -1331,38 +1326,111 @@ void OPNABase::Mix6(Sample* buffer, int nsamples, int activech)
 {
 	// Mix
 	// libOPNMIDI: rewrite for panning support
+	// fmprog: channel by channel, a block at a time, then panned
 
 	const uint activechmask[6] = {0x001, 0x004, 0x010, 0x040, 0x100, 0x400};
+	const bool lfo = (activech & 0xaaa) != 0;
 
-	Sample* limit = buffer + nsamples * 2;
-	for (Sample* dest = buffer; dest < limit; dest+=2)
+	// the silent channels add nothing to the mix
+	uint chs[6];
+	int panl[6], panr[6];
+	uint nch = 0;
+	for (uint c = 0; c<6; ++c)
 	{
-		ISample out[6];
-		if (activech & 0xaaa)
+		if (activechmask[c] & activech)
 		{
-			LFO();
-			for (uint c = 0; c<6; ++c)
-				out[c] = (activechmask[c] & activech) ? ch[c].CalcL() : 0;
+			chs[nch] = c;
+			panl[nch] = (pan[c] & 2) ? panvolume_l[c] : 0;
+			panr[nch] = (pan[c] & 1) ? panvolume_r[c] : 0;
+			++nch;
 		}
-		else
+	}
+
+	ISample out[6][FM_MIXBLOCK];
+	uint8 pml[FM_MIXBLOCK], aml[FM_MIXBLOCK];
+
+	for (int done = 0; done < nsamples; done += FM_MIXBLOCK)
+	{
+		int count = Min(nsamples - done, FM_MIXBLOCK);
+		if (lfo)
+			LFOBlock(pml, aml, count);
+		for (uint k = 0; k<nch; ++k)
+			ch[chs[k]].CalcBlock(out[k], count, lfo ? pml : 0, lfo ? aml : 0);
+
+		Sample* dest = buffer + 2 * done;
+		for (int i = 0; i < count; ++i, dest+=2)
 		{
-			for (uint c = 0; c<6; ++c)
-				out[c] = (activechmask[c] & activech) ? ch[c].Calc() : 0;
+			int lrouts[2] = {0, 0};
+			for (uint k = 0; k<nch; ++k)
+			{
+				lrouts[0] += out[k][i] * panl[k] / 65535;
+				lrouts[1] += out[k][i] * panr[k] / 65535;
+			}
+
+			StoreSample(dest[0], lrouts[0]);
+			StoreSample(dest[1], lrouts[1]);
 		}
+	}
+}
 
-		int lrouts[2] = {0, 0};
-		for (uint c = 0; c<6; ++c)
+// ---------------------------------------------------------------------------
+//	fmprog: FM channels apart, at the level of a centered channel in Mix6
+//	in:		dest		one buffer per channel, or NULL to skip it
+//			nsamples	number of samples
+//
+void OPNABase::MixChannels(ISample** dest, int nsamples)
+{
+	int act = 0;
+	if (fmvolume > 0)
+	{
+		// unlike FMMix, leave channel 3 alone in normal mode: setting its
+		// F-Number again would restart its SSG-EG at every call
+		if (regtc & 0xc0)
 		{
-			int panl = panvolume_l[c];
-			int panr = panvolume_r[c];
-			panl = (pan[c] & 2) ? panl : 0;
-			panr = (pan[c] & 1) ? panr : 0;
-			lrouts[0] += out[c] * panl / 65535;
-			lrouts[1] += out[c] * panr / 65535;
+			csmch->op[0].SetFNum(fnum3[1]);	csmch->op[1].SetFNum(fnum3[2]);
+			csmch->op[2].SetFNum(fnum3[0]);	csmch->op[3].SetFNum(fnum[2]);
 		}
 
-		StoreSample(dest[0], lrouts[0]);
-		StoreSample(dest[1], lrouts[1]);
+		act = (((ch[2].Prepare() << 2) | ch[1].Prepare()) << 2) | ch[0].Prepare();
+		if (reg29 & 0x80)
+			act |= (ch[3].Prepare() | ((ch[4].Prepare() | (ch[5].Prepare() << 2)) << 2)) << 6;
+		if (!(reg22 & 0x08))
+			act &= 0x555;
+	}
+
+	const uint activechmask[6] = {0x001, 0x004, 0x010, 0x040, 0x100, 0x400};
+	const int panl = panlawtable[64];
+
+	for (uint c = 0; c<6; ++c)
+	{
+		if (dest[c] && !(activechmask[c] & act))
+			memset(dest[c], 0, nsamples * sizeof(ISample));
+	}
+
+	if (!(act & 0x555))
+		return;
+
+	const bool lfo = (act & 0xaaa) != 0;
+	ISample skipped[FM_MIXBLOCK];
+	uint8 pml[FM_MIXBLOCK], aml[FM_MIXBLOCK];
+
+	for (int done = 0; done < nsamples; done += FM_MIXBLOCK)
+	{
+		int count = Min(nsamples - done, FM_MIXBLOCK);
+		if (lfo)
+			LFOBlock(pml, aml, count);
+		for (uint c = 0; c<6; ++c)
+		{
+			if (!(activechmask[c] & act))
+				continue;
+			ISample* out = dest[c] ? dest[c] + done : skipped;
+			ch[c].CalcBlock(out, count, lfo ? pml : 0, lfo ? aml : 0);
+			if (dest[c])
+			{
+				for (int i = 0; i < count; ++i)
+					out[i] = out[i] * panl / 65535;
+			}
+		}
 	}
 }
 
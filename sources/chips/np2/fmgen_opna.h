@@ -121,7 +121,8 @@ namespace FM
 		Channel4* csmch;
 		
 
-		static  uint32 lfotable[8];
+		// fmprog: it depends on the clock ratio, which is the chip's own
+		uint32	lfotable[8];
 	
 	private:
 		void	TimerA();
@@ -190,6 +191,9 @@ namespace FM
 
 		// libOPNMIDI: soft panning
 		void	SetPan(uint c, uint8 p);
+
+		// fmprog: FM channels apart, unpanned and unclipped
+		void	MixChannels(ISample** dest, int nsamples);
 	
 		void	DataSave(struct OPNABaseData* data);
 		void	DataLoad(struct OPNABaseData* data);
@@ -197,7 +201,7 @@ namespace FM
 	private:
 		virtual void Intr(bool) {}
 
-		void	MakeTable2();
+		static void	MakeTable2();
 	
 	protected:
 		bool	Init(uint c, uint r, bool);
@@ -218,7 +222,7 @@ namespace FM
 		void	SetStatus(uint bit);
 		void	ResetStatus(uint bit);
 		void	UpdateStatus();
-		void	LFO();
+		void	LFOBlock(uint8* pml, uint8* aml, int nsamples);
 
 		void	DecodeADPCMB();
 		void	ADPCMBMix(Sample* dest, uint count);
@@ -284,7 +288,6 @@ namespace FM
 		static int amtable[FM_LFOENTS];
 		static int pmtable[FM_LFOENTS];
 		static int32 tltable[FM_TLENTS+FM_TLPOS];
-		static bool	tablehasmade;
 	};
 
 	//	YM2203(OPN) ----------------------------------------------------
@@ -8,13 +8,15 @@
 #include "fmgen_misc.h"
 #include "fmgen_psg.h"
 
+static std::once_flag noise_table;
+
 // ---------------------------------------------------------------------------
 //	コンストラクタ・デストラクタ
 //
 PSG::PSG()
 {
 	SetVolume(0);
-	MakeNoiseTable();
+	std::call_once(noise_table, MakeNoiseTable);
 	Reset();
 	mask = 0x3f;
 }
@@ -64,19 +66,16 @@ void PSG::SetClock(int clock, int rate)
 //
 void PSG::MakeNoiseTable()
 {
-	if (!noisetable[0])
+	int noise = 14321;
+	for (int i=0; i<noisetablesize; i++)
 	{
-		int noise = 14321;
-		for (int i=0; i<noisetablesize; i++)
+		int n = 0;
+		for (int j=0; j<32; j++)
 		{
-			int n = 0;
-			for (int j=0; j<32; j++)
-			{
-				n = n * 2 + (noise & 1);
-				noise = (noise >> 1) | (((noise << 14) ^ (noise << 16)) & 0x10000);
-			}
-			noisetable[i] = n;
+			n = n * 2 + (noise & 1);
+			noise = (noise >> 1) | (((noise << 14) ^ (noise << 16)) & 0x10000);
 		}
+		noisetable[i] = n;
 	}
 }
 
@@ -390,6 +389,6 @@ void PSG::Mix(Sample* dest, int nsamples)
 // ---------------------------------------------------------------------------
 //	テーブル
 //
-uint	PSG::noisetable[noisetablesize] = { 0, };
-int		PSG::EmitTable[0x20] = { -1, };
-uint	PSG::enveloptable[16][64] = { {0, } };
+// fmprog: the noise is the same for all the chips, and made once; the
+// output tables depend on the volume of each chip, and are its own
+alignas(64) uint	PSG::noisetable[noisetablesize];
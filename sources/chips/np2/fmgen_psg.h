@@ -90,7 +90,7 @@ public:
 	void DataLoad(struct PSGData* data);
 	
 protected:
-	void MakeNoiseTable();
+	static void MakeNoiseTable();
 	void MakeEnvelopTable();
 	static void StoreSample(Sample& dest, int32 data);
 	
@@ -107,9 +107,9 @@ protected:
 	int volume;
 	int mask;
 
-	static uint enveloptable[16][64];
+	uint enveloptable[16][64];
 	static uint noisetable[noisetablesize];
-	static int EmitTable[32];
+	int EmitTable[32];
 };
 
 #endif // PSG_H
@@ -78,6 +78,49 @@ void NP2OPNA<ChipType>::nativeGenerateN(int16_t *output, size_t frames)
     chip->Mix(output, static_cast<int>(frames));
 }
 
+template <class ChipType>
+void NP2OPNA<ChipType>::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    chip->MixChannels(output, static_cast<int>(frames));
+}
+
+template <>
+size_t NP2OPNA<FM::OPNA>::nativeStateSize() const
+{
+    return sizeof(FM::OPNAData);
+}
+
+template <>
+void NP2OPNA<FM::OPNA>::nativeSaveState(void *state) const
+{
+    chip->DataSave(static_cast<FM::OPNAData *>(state));
+}
+
+template <>
+void NP2OPNA<FM::OPNA>::nativeLoadState(const void *state)
+{
+    chip->DataLoad(static_cast<FM::OPNAData *>(const_cast<void *>(state)));
+}
+
+// the ADPCM-A ROM is outside the state, there is none loaded here
+template <>
+size_t NP2OPNA<FM::OPNB>::nativeStateSize() const
+{
+    return sizeof(FM::OPNBData);
+}
+
+template <>
+void NP2OPNA<FM::OPNB>::nativeSaveState(void *state) const
+{
+    chip->DataSave(static_cast<FM::OPNBData *>(state), NULL);
+}
+
+template <>
+void NP2OPNA<FM::OPNB>::nativeLoadState(const void *state)
+{
+    chip->DataLoad(static_cast<FM::OPNBData *>(const_cast<void *>(state)), NULL);
+}
+
 template <>
 const char *NP2OPNA<FM::OPNA>::emulatorName()
 {
@@ -41,6 +41,10 @@ public:
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerateN(int16_t *output, size_t frames) override;
+    void nativeGenerateChannels(int32_t *output[6], size_t frames);
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeLoadState(const void *state);
     const char *emulatorName() override;
     enum { resamplerPostAttenuate = 2 };
 };
@@ -244,7 +244,7 @@ static const Bit16u panlawtable[] =
 
 static Bit32u chip_type = ym3438_mode_readmode;
 
-void OPN2_DoIO(ym3438_t *chip)
+static void OPN2_DoIO(ym3438_t *chip)
 {
     /* Write signal check */
     chip->write_a_en = (chip->write_a & 0x03) == 0x01;
@@ -258,7 +258,7 @@ void OPN2_DoIO(ym3438_t *chip)
     chip->write_busy_cnt &= 0x1f;
 }
 
-void OPN2_DoRegWrite(ym3438_t *chip)
+static void OPN2_DoRegWrite(ym3438_t *chip)
 {
     Bit32u i;
     Bit32u slot = chip->cycles % 12;
@@ -477,7 +477,7 @@ void OPN2_DoRegWrite(ym3438_t *chip)
     }
 }
 
-void OPN2_PhaseCalcIncrement(ym3438_t *chip)
+static void OPN2_PhaseCalcIncrement(ym3438_t *chip)
 {
     Bit32u chan = chip->channel;
     Bit32u slot = chip->cycles;
@@ -546,7 +546,7 @@ void OPN2_PhaseCalcIncrement(ym3438_t *chip)
     chip->pg_inc[slot] &= 0xfffff;
 }
 
-void OPN2_PhaseGenerate(ym3438_t *chip)
+static void OPN2_PhaseGenerate(ym3438_t *chip)
 {
     Bit32u slot;
     /* Mask increment */
@@ -565,7 +565,7 @@ void OPN2_PhaseGenerate(ym3438_t *chip)
     }
 }
 
-void OPN2_EnvelopeSSGEG(ym3438_t *chip)
+static void OPN2_EnvelopeSSGEG(ym3438_t *chip)
 {
     Bit32u slot = chip->cycles;
     Bit8u direction = 0;
@@ -612,7 +612,7 @@ void OPN2_EnvelopeSSGEG(ym3438_t *chip)
     chip->eg_ssg_enable[slot] = (chip->ssg_eg[slot] >> 3) & 0x01;
 }
 
-void OPN2_EnvelopeADSR(ym3438_t *chip)
+static void OPN2_EnvelopeADSR(ym3438_t *chip)
 {
     Bit32u slot = (chip->cycles + 22) % 24;
 
@@ -736,7 +736,7 @@ void OPN2_EnvelopeADSR(ym3438_t *chip)
     chip->eg_state[slot] = nextstate;
 }
 
-void OPN2_EnvelopePrepare(ym3438_t *chip)
+static void OPN2_EnvelopePrepare(ym3438_t *chip)
 {
     Bit8u rate;
     Bit8u sum;
@@ -824,7 +824,7 @@ void OPN2_EnvelopePrepare(ym3438_t *chip)
     chip->eg_sl[0] = chip->sl[slot];
 }
 
-void OPN2_EnvelopeGenerate(ym3438_t *chip)
+static void OPN2_EnvelopeGenerate(ym3438_t *chip)
 {
     Bit32u slot = (chip->cycles + 23) % 24;
     Bit16u level;
@@ -857,7 +857,7 @@ void OPN2_EnvelopeGenerate(ym3438_t *chip)
     chip->eg_out[slot] = level;
 }
 
-void OPN2_UpdateLFO(ym3438_t *chip)
+static void OPN2_UpdateLFO(ym3438_t *chip)
 {
     if ((chip->lfo_quotient & lfo_cycles[chip->lfo_freq]) == lfo_cycles[chip->lfo_freq])
     {
@@ -871,7 +871,7 @@ void OPN2_UpdateLFO(ym3438_t *chip)
     chip->lfo_cnt &= chip->lfo_en;
 }
 
-void OPN2_FMPrepare(ym3438_t *chip)
+static void OPN2_FMPrepare(ym3438_t *chip)
 {
     Bit32u slot = (chip->cycles + 6) % 24;
     Bit32u channel = chip->channel;
@@ -933,7 +933,7 @@ void OPN2_FMPrepare(ym3438_t *chip)
     }
 }
 
-void OPN2_ChGenerate(ym3438_t *chip)
+static void OPN2_ChGenerate(ym3438_t *chip)
 {
     Bit32u slot = (chip->cycles + 18) % 24;
     Bit32u channel = chip->channel;
@@ -968,7 +968,7 @@ void OPN2_ChGenerate(ym3438_t *chip)
     chip->ch_acc[channel] = sum;
 }
 
-void OPN2_ChOutput(ym3438_t *chip)
+static void OPN2_ChOutput(ym3438_t *chip)
 {
     Bit32u cycles = chip->cycles;
     Bit32u slot = chip->cycles;
@@ -1033,9 +1033,11 @@ void OPN2_ChOutput(ym3438_t *chip)
         {
             chip->mor = sign;
         }
+        chip->mo = out_en ? out : sign;
         /* Amplify signal */
         chip->mol *= 3;
         chip->mor *= 3;
+        chip->mo *= 3;
     }
     else
     {
@@ -1048,10 +1050,11 @@ void OPN2_ChOutput(ym3438_t *chip)
         {
             chip->mor = out;
         }
+        chip->mo = out_en ? out : 0;
     }
 }
 
-void OPN2_FMGenerate(ym3438_t *chip)
+static void OPN2_FMGenerate(ym3438_t *chip)
 {
     Bit32u slot = (chip->cycles + 19) % 24;
     /* Calculate phase */
@@ -1089,7 +1092,7 @@ void OPN2_FMGenerate(ym3438_t *chip)
     chip->fm_out[slot] = output;
 }
 
-void OPN2_DoTimerA(ym3438_t *chip)
+static void OPN2_DoTimerA(ym3438_t *chip)
 {
     Bit16u time;
     Bit8u load;
@@ -1138,7 +1141,7 @@ void OPN2_DoTimerA(ym3438_t *chip)
     chip->timer_a_cnt = time & 0x3ff;
 }
 
-void OPN2_DoTimerB(ym3438_t *chip)
+static void OPN2_DoTimerB(ym3438_t *chip)
 {
     Bit16u time;
     Bit8u load;
@@ -1183,7 +1186,7 @@ void OPN2_DoTimerB(ym3438_t *chip)
     chip->timer_b_cnt = time & 0xff;
 }
 
-void OPN2_KeyOn(ym3438_t*chip)
+static void OPN2_KeyOn(ym3438_t*chip)
 {
     Bit32u slot = chip->cycles;
     Bit32u chan = chip->channel;
@@ -1505,6 +1508,22 @@ void OPN2_WriteBuffered(ym3438_t *chip, Bit32u port, Bit8u data)
     chip->writebuf_last = (chip->writebuf_last + 1) % OPN_WRITEBUF_SIZE;
 }
 
+static void OPN2_FlushWriteBuf(ym3438_t *chip)
+{
+    while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+    {
+        if (!(chip->writebuf[chip->writebuf_cur].port & 0x04))
+        {
+            break;
+        }
+        chip->writebuf[chip->writebuf_cur].port &= 0x03;
+        OPN2_Write(chip, chip->writebuf[chip->writebuf_cur].port,
+                   chip->writebuf[chip->writebuf_cur].data);
+        chip->writebuf_cur = (chip->writebuf_cur + 1) % OPN_WRITEBUF_SIZE;
+    }
+    chip->writebuf_samplecnt++;
+}
+
 void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
 {
     Bit32u i;
@@ -1559,18 +1578,137 @@ void OPN2_Generate(ym3438_t *chip, Bit16s *buf)
             buf[1] += buffer[1];
         }
 
-        while (chip->writebuf[chip->writebuf_cur].time <= chip->writebuf_samplecnt)
+        OPN2_FlushWriteBuf(chip);
+    }
+}
+
+/* the channel which outputs at each quarter of the 24 cycles */
+static const Bit8u cyclechannel[6] = { 1, 5, 3, 0, 4, 2 };
+
+/* EXTRA: a write which is applied before returning, for the offline setup
+   of the registers. The chip is clocked silently for as long as the write
+   takes to reach its register, instead of waiting in the write buffer for
+   its time: the cycles run here are not on the time line of the buffer. */
+void OPN2_WriteDirect(ym3438_t *chip, Bit32u port, Bit8u data)
+{
+    Bit16s buffer[2];
+    Bit32u cycles;
+
+    /* the buffered writes go first, in order */
+    if (chip->writebuf[chip->writebuf_cur].port & 0x04)
+    {
+        while (chip->writebuf[chip->writebuf_cur].port & 0x04)
+        {
+            OPN2_FlushWriteBuf(chip);
+            OPN2_Clock(chip, buffer);
+        }
+        for (cycles = 0; cycles < 24; cycles++)
         {
-            if (!(chip->writebuf[chip->writebuf_cur].port & 0x04))
+            OPN2_Clock(chip, buffer);
+        }
+    }
+
+    OPN2_Write(chip, port, data);
+    if (!(port & 1))
+    {
+        /* the address is latched, and the write signal goes low again */
+        cycles = 2;
+    }
+    else if (chip->write_fm_mode_a == 0x28)
+    {
+        /* key on/off reaches the channel at its turn in the 24 cycles */
+        cycles = 25;
+    }
+    else
+    {
+        /* the data is latched, then every slot is visited in 12 cycles */
+        cycles = 13;
+    }
+    while (cycles--)
+    {
+        OPN2_Clock(chip, buffer);
+    }
+}
+
+/* OPN2_FlushWriteBuf, with a quick way out when nothing is buffered */
+static void OPN2_ServiceWriteBuf(ym3438_t *chip)
+{
+    if (chip->writebuf[chip->writebuf_cur].port & 0x04)
+    {
+        OPN2_FlushWriteBuf(chip);
+    }
+    else
+    {
+        chip->writebuf_samplecnt++;
+    }
+}
+
+/* OPN2_Generate for a block of samples: the mute and pan settings of the
+   channels are looked up once per block instead of at every cycle */
+void OPN2_GenerateBlock(ym3438_t *chip, Bit16s *output, Bit32u numsamples)
+{
+    Bit32u gain_l[7], gain_r[7];
+    Bit32u i, j, c;
+    Bit16s buffer[2];
+
+    /* a zero gain for a muted channel; the 7th is channel 6 as the DAC */
+    for (c = 0; c < 7; c++)
+    {
+        Bit32u channel = (c < 6) ? c : 5;
+        gain_l[c] = chip->mute[c] ? 0 : chip->pan_volume_l[channel];
+        gain_r[c] = chip->mute[c] ? 0 : chip->pan_volume_r[channel];
+    }
+
+    for (i = 0; i < numsamples; i++)
+    {
+        Bit32s out_l = 0;
+        Bit32s out_r = 0;
+
+        for (j = 0; j < 24; j++)
+        {
+            Bit32u channel = cyclechannel[chip->cycles >> 2];
+            Bit32u g = (channel == 5) ? 5u + chip->dacen : channel;
+            OPN2_Clock(chip, buffer);
+            /* the same arithmetic as OPN2_Generate, to the rounding */
+            out_l += (Bit16s)(buffer[0] * gain_l[g] / 65535);
+            out_r += (Bit16s)(buffer[1] * gain_r[g] / 65535);
+            OPN2_ServiceWriteBuf(chip);
+        }
+
+        *output++ = (Bit16s)out_l;
+        *output++ = (Bit16s)out_r;
+    }
+}
+
+void OPN2_GenerateChannels(ym3438_t *chip, Bit32s *output[6], Bit32u numsamples)
+{
+    Bit32u i, j, c;
+    Bit16s buffer[2];
+
+    for (i = 0; i < numsamples; i++)
+    {
+        Bit32s out[6] = { 0, 0, 0, 0, 0, 0 };
+
+        for (j = 0; j < 24; j++)
+        {
+            Bit32u channel = cyclechannel[chip->cycles >> 2];
+            Bit32u mute = chip->mute[(channel == 5) ? 5u + chip->dacen : channel];
+            OPN2_Clock(chip, buffer);
+            if (!mute)
             {
-                break;
+                /* at the level of a centered channel in the stereo output */
+                out[channel] += (Bit16s)(chip->mo * panlawtable[64] / 65535);
+            }
+            OPN2_ServiceWriteBuf(chip);
+        }
+
+        for (c = 0; c < 6; c++)
+        {
+            if (output[c])
+            {
+                output[c][i] = out[c];
             }
-            chip->writebuf[chip->writebuf_cur].port &= 0x03;
-            OPN2_Write(chip, chip->writebuf[chip->writebuf_cur].port,
-                       chip->writebuf[chip->writebuf_cur].data);
-            chip->writebuf_cur = (chip->writebuf_cur + 1) % OPN_WRITEBUF_SIZE;
         }
-        chip->writebuf_samplecnt++;
     }
 }
 
@@ -69,6 +69,7 @@ typedef struct
     Bit32u cycles;
     Bit32u channel;
     Bit16s mol, mor;
+    Bit16s mo; /* EXTRA: output as if panned to both sides */
     /* IO */
     Bit16u write_data;
     Bit8u write_a;
@@ -237,10 +238,13 @@ Bit8u OPN2_Read(ym3438_t *chip, Bit32u port);
 /*EXTRA*/
 void OPN2_WritePan(ym3438_t *chip, Bit32u channel, Bit8u data);
 void OPN2_WriteBuffered(ym3438_t *chip, Bit32u port, Bit8u data);
+void OPN2_WriteDirect(ym3438_t *chip, Bit32u port, Bit8u data);
 void OPN2_Generate(ym3438_t *chip, Bit16s *buf);
 void OPN2_GenerateResampled(ym3438_t *chip, Bit16s *buf);
 void OPN2_GenerateStream(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
 void OPN2_GenerateStreamMix(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
+void OPN2_GenerateBlock(ym3438_t *chip, Bit16s *output, Bit32u numsamples);
+void OPN2_GenerateChannels(ym3438_t *chip, Bit32s *output[6], Bit32u numsamples);
 void OPN2_SetMute(ym3438_t *chip, Bit32u mute);
 
 #ifdef __cplusplus
@@ -23,7 +23,7 @@
 #include <cstring>
 
 NukedOPN2::NukedOPN2(OPNFamily f)
-    : OPNChipBaseT(f)
+    : OPNChipBaseT(f), m_directWrites(false)
 {
     OPN2_SetChipType(ym3438_mode_readmode);
     chip = new ym3438_t;
@@ -53,6 +53,12 @@ void NukedOPN2::reset()
 void NukedOPN2::writeReg(uint32_t port, uint16_t addr, uint8_t data)
 {
     ym3438_t *chip_r = reinterpret_cast<ym3438_t*>(chip);
+    if(m_directWrites)
+    {
+        OPN2_WriteDirect(chip_r, 0 + (port) * 2, (uint8_t)addr);
+        OPN2_WriteDirect(chip_r, 1 + (port) * 2, data);
+        return;
+    }
     OPN2_WriteBuffered(chip_r, 0 + (port) * 2, (uint8_t)addr);
     OPN2_WriteBuffered(chip_r, 1 + (port) * 2, data);
     //qDebug() << QString("%1: 0x%2 => 0x%3").arg(port).arg(addr, 2, 16, QChar('0')).arg(data, 2, 16, QChar('0'));
@@ -70,6 +76,37 @@ void NukedOPN2::nativeGenerate(int16_t *frame)
     OPN2_Generate(chip_r, frame);
 }
 
+void NukedOPN2::nativeGenerateBlock(int16_t *output, size_t frames)
+{
+#if defined(OPNMIDI_AUDIO_TICK_HANDLER)
+    OPNChipBaseT::nativeGenerateBlock(output, frames);
+#else
+    ym3438_t *chip_r = reinterpret_cast<ym3438_t*>(chip);
+    OPN2_GenerateBlock(chip_r, output, static_cast<Bit32u>(frames));
+#endif
+}
+
+void NukedOPN2::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    ym3438_t *chip_r = reinterpret_cast<ym3438_t*>(chip);
+    OPN2_GenerateChannels(chip_r, output, static_cast<Bit32u>(frames));
+}
+
+size_t NukedOPN2::nativeStateSize() const
+{
+    return sizeof(ym3438_t);
+}
+
+void NukedOPN2::nativeSaveState(void *state) const
+{
+    std::memcpy(state, chip, sizeof(ym3438_t));
+}
+
+void NukedOPN2::nativeLoadState(const void *state)
+{
+    std::memcpy(chip, state, sizeof(ym3438_t));
+}
+
 const char *NukedOPN2::emulatorName()
 {
     return "Nuked OPN2";
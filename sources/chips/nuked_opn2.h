@@ -26,6 +26,7 @@
 class NukedOPN2 final : public OPNChipBaseT<NukedOPN2>
 {
     void *chip;
+    bool m_directWrites;
 public:
     explicit NukedOPN2(OPNFamily f);
     ~NukedOPN2() override;
@@ -35,9 +36,20 @@ public:
     void reset() override;
     void writeReg(uint32_t port, uint16_t addr, uint8_t data) override;
     void writePan(uint16_t chan, uint8_t data) override;
+    // offline mode: the register writes are applied before `writeReg`
+    // returns, by clocking the chip silently, instead of being queued with
+    // the delays of the real chip; for the setup of patches before
+    // rendering, or after loading a state. It is off for real-time play.
+    void setDirectWrites(bool direct) { m_directWrites = direct; }
+    bool directWrites() const { return m_directWrites; }
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
     void nativeGenerate(int16_t *frame) override;
+    void nativeGenerateBlock(int16_t *output, size_t frames);
+    void nativeGenerateChannels(int32_t *output[6], size_t frames);
+    size_t nativeStateSize() const;
+    void nativeSaveState(void *state) const;
+    void nativeLoadState(const void *state);
     const char *emulatorName() override;
     // amplitude scale factors to use in resampling
     enum { resamplerPreAmplify = 11, resamplerPostAttenuate = 2 };
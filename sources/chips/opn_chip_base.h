@@ -80,6 +80,21 @@ public:
     virtual void generateAndMix(int16_t *output, size_t frames) = 0;
     virtual void generate32(int32_t *output, size_t frames) = 0;
     virtual void generateAndMix32(int32_t *output, size_t frames) = 0;
+    // the 6 FM channels apart, without panning, at the level of a centered
+    // channel in the stereo output; there is no resampling, frames are at
+    // the effective rate. A null output skips the channel. Emulators which
+    // render by buffers drop the frames left in the buffer of `generate`,
+    // up to a buffer of them: a caller mixing both jumps ahead in time.
+    virtual void generateChannels(int32_t *output[6], size_t frames) = 0;
+    // the same, in floating point, normalized so that full scale is 1.0
+    virtual void generateChannelsFloat(float *output[6], size_t frames) = 0;
+
+    // snapshots of the emulator state, in a blob of `stateSize()` bytes
+    // aligned like by `malloc`; a state can be loaded into an emulator of
+    // the same kind, which runs with the same rates
+    virtual size_t stateSize() const = 0;
+    virtual void saveState(void *state) const = 0;
+    virtual void loadState(const void *state) = 0;
 
     virtual const char* emulatorName() = 0;
 private:
@@ -113,12 +128,28 @@ public:
     void generateAndMix(int16_t *output, size_t frames) override;
     void generate32(int32_t *output, size_t frames) override;
     void generateAndMix32(int32_t *output, size_t frames) override;
+    void generateChannels(int32_t *output[6], size_t frames) override;
+    void generateChannelsFloat(float *output[6], size_t frames) override;
+    // generate native frames into a stereo buffer, with no scaling;
+    // implementations may redefine it to produce blocks more efficiently
+    void nativeGenerateBlock(int16_t *output, size_t frames);
+    size_t stateSize() const override;
+    void saveState(void *state) const override;
+    void loadState(const void *state) override;
+protected:
+    // the state blobs put the parts of every level at this alignment
+    enum { stateAlignment = 16 };
+    static size_t alignStateSize(size_t size)
+        { return (size + stateAlignment - 1) & ~(size_t)(stateAlignment - 1); }
 private:
     bool m_runningAtPcmRate;
 #if defined(OPNMIDI_AUDIO_TICK_HANDLER)
     void *m_audioTickHandlerInstance;
 #endif
     void nativeTick(int16_t *frame);
+    void nativeGenerateChannelsTicked(int32_t *output[6], size_t frames);
+    bool isPassthrough() const;
+    void passthroughGenerate(int32_t *output, size_t frames);
     void setupResampler(uint32_t rate);
     void resetResampler();
     void resampledGenerate(int32_t *output);
@@ -131,6 +162,12 @@ private:
     int32_t m_rateratio;
     enum { rsm_frac = 10 };
 #endif
+    struct ResamplerState
+    {
+        int32_t oldsamples[2];
+        int32_t samples[2];
+        int32_t samplecnt;
+    };
     // amplitude scale factors in and out of resampler, varying for chips;
     // values are OK to "redefine", the static polymorphism will accept it.
     enum { resamplerPreAmplify = 1, resamplerPostAttenuate = 1 };
@@ -151,11 +188,22 @@ public:
 public:
     void reset() override;
     void nativeGenerate(int16_t *frame) override;
+    void generateChannels(int32_t *output[6], size_t frames) override;
+    void generateChannelsFloat(float *output[6], size_t frames) override;
+    void nativeGenerateBlock(int16_t *output, size_t frames);
+    size_t stateSize() const override;
+    void saveState(void *state) const override;
+    void loadState(const void *state) override;
 protected:
     virtual void nativeGenerateN(int16_t *output, size_t frames) = 0;
 private:
     unsigned m_bufferIndex;
     int16_t m_buffer[2 * Buffer];
+    struct BufferState
+    {
+        unsigned bufferIndex;
+        int16_t buffer[2 * Buffer];
+    };
 };
 
 #include "opn_chip_base.tcc"
@@ -1,5 +1,6 @@
 #include "opn_chip_base.h"
 #include <cmath>
+#include <cstring>
 #include <cstdio>
 
 #if defined(OPNMIDI_ENABLE_HQ_RESAMPLER)
@@ -135,6 +136,22 @@ template <class T>
 void OPNChipBaseT<T>::generate(int16_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
+    if(isPassthrough())
+    {
+        static_cast<T *>(this)->nativeGenerateBlock(output, frames);
+        if((int)T::resamplerPreAmplify != (int)T::resamplerPostAttenuate)
+        {
+            for(size_t i = 0; i < 2 * frames; ++i)
+            {
+                int32_t temp = (int32_t)output[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+                temp = (temp > -32768) ? temp : -32768;
+                temp = (temp < 32767) ? temp : 32767;
+                output[i] = (int16_t)temp;
+            }
+        }
+        static_cast<T *>(this)->nativePostGenerate();
+        return;
+    }
     for(size_t i = 0; i < frames; ++i)
     {
         int32_t frame[2];
@@ -154,10 +171,14 @@ template <class T>
 void OPNChipBaseT<T>::generateAndMix(int16_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
+    const bool passthrough = isPassthrough();
     for(size_t i = 0; i < frames; ++i)
     {
         int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
+        if(passthrough)
+            passthroughGenerate(frame, 1);
+        else
+            static_cast<T *>(this)->resampledGenerate(frame);
         for (unsigned c = 0; c < 2; ++c) {
             int32_t temp = (int32_t)output[c] + frame[c];
             temp = (temp > -32768) ? temp : -32768;
@@ -173,6 +194,12 @@ template <class T>
 void OPNChipBaseT<T>::generate32(int32_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
+    if(isPassthrough())
+    {
+        passthroughGenerate(output, frames);
+        static_cast<T *>(this)->nativePostGenerate();
+        return;
+    }
     for(size_t i = 0; i < frames; ++i)
     {
         static_cast<T *>(this)->resampledGenerate(output);
@@ -185,10 +212,14 @@ template <class T>
 void OPNChipBaseT<T>::generateAndMix32(int32_t *output, size_t frames)
 {
     static_cast<T *>(this)->nativePreGenerate();
+    const bool passthrough = isPassthrough();
     for(size_t i = 0; i < frames; ++i)
     {
         int32_t frame[2];
-        static_cast<T *>(this)->resampledGenerate(frame);
+        if(passthrough)
+            passthroughGenerate(frame, 1);
+        else
+            static_cast<T *>(this)->resampledGenerate(frame);
         output[0] += frame[0];
         output[1] += frame[1];
         output += 2;
@@ -196,6 +227,151 @@ void OPNChipBaseT<T>::generateAndMix32(int32_t *output, size_t frames)
     static_cast<T *>(this)->nativePostGenerate();
 }
 
+template <class T>
+void OPNChipBaseT<T>::generateChannels(int32_t *output[6], size_t frames)
+{
+    nativeGenerateChannelsTicked(output, frames);
+
+    if((int)T::resamplerPreAmplify != (int)T::resamplerPostAttenuate)
+    {
+        for(unsigned c = 0; c < 6; ++c)
+        {
+            int32_t *out = output[c];
+            for(size_t i = 0; out && i < frames; ++i)
+                out[i] = out[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+        }
+    }
+}
+
+template <class T>
+void OPNChipBaseT<T>::generateChannelsFloat(float *output[6], size_t frames)
+{
+    // the chip amplification and the normalization are one multiplication
+    const float gain = (float)T::resamplerPreAmplify / ((float)T::resamplerPostAttenuate * 32768.0f);
+
+    enum { chunk_size = 256 };
+    int32_t chunk[6][chunk_size];
+
+    for(size_t offset = 0; offset < frames; )
+    {
+        size_t count = frames - offset;
+        count = (count < (size_t)chunk_size) ? count : (size_t)chunk_size;
+
+        int32_t *temp[6];
+        for(unsigned c = 0; c < 6; ++c)
+            temp[c] = output[c] ? chunk[c] : NULL;
+        nativeGenerateChannelsTicked(temp, count);
+
+        for(unsigned c = 0; c < 6; ++c)
+        {
+            float *out = output[c];
+            for(size_t i = 0; out && i < count; ++i)
+                out[offset + i] = (float)chunk[c][i] * gain;
+        }
+        offset += count;
+    }
+}
+
+template <class T>
+void OPNChipBaseT<T>::nativeGenerateChannelsTicked(int32_t *output[6], size_t frames)
+{
+    static_cast<T *>(this)->nativePreGenerate();
+#if defined(OPNMIDI_AUDIO_TICK_HANDLER)
+    for(size_t i = 0; i < frames; ++i)
+    {
+        opn2_audioTickHandler(m_audioTickHandlerInstance, m_id, effectiveRate());
+        int32_t *frame[6];
+        for(unsigned c = 0; c < 6; ++c)
+            frame[c] = output[c] ? &output[c][i] : NULL;
+        static_cast<T *>(this)->nativeGenerateChannels(frame, 1);
+    }
+#else
+    static_cast<T *>(this)->nativeGenerateChannels(output, frames);
+#endif
+    static_cast<T *>(this)->nativePostGenerate();
+}
+
+template <class T>
+void OPNChipBaseT<T>::nativeGenerateBlock(int16_t *output, size_t frames)
+{
+    for(size_t i = 0; i < frames; ++i)
+    {
+        static_cast<T *>(this)->nativeTick(output);
+        output += 2;
+    }
+}
+
+template <class T>
+bool OPNChipBaseT<T>::isPassthrough() const
+{
+    // at the rate of the clock, frames go out as the chip makes them; the
+    // chip makes a frame every 144 cycles, whatever clock it is given
+    return m_runningAtPcmRate || m_rate == m_clock / 144;
+}
+
+template <class T>
+void OPNChipBaseT<T>::passthroughGenerate(int32_t *output, size_t frames)
+{
+    enum { chunk_size = 256 };
+    int16_t chunk[2 * chunk_size];
+
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)chunk_size) ? frames : (size_t)chunk_size;
+        static_cast<T *>(this)->nativeGenerateBlock(chunk, count);
+        for(size_t i = 0; i < 2 * count; ++i)
+            output[i] = (int32_t)chunk[i] * T::resamplerPreAmplify / T::resamplerPostAttenuate;
+        output += 2 * count;
+        frames -= count;
+    }
+}
+
+template <class T>
+size_t OPNChipBaseT<T>::stateSize() const
+{
+#if defined(OPNMIDI_ENABLE_HQ_RESAMPLER)
+    size_t resamplerSize = 0;
+#else
+    size_t resamplerSize = alignStateSize(sizeof(ResamplerState));
+#endif
+    return resamplerSize + static_cast<const T *>(this)->nativeStateSize();
+}
+
+template <class T>
+void OPNChipBaseT<T>::saveState(void *state) const
+{
+    uint8_t *data = static_cast<uint8_t *>(state);
+#if !defined(OPNMIDI_ENABLE_HQ_RESAMPLER)
+    ResamplerState *rsm = reinterpret_cast<ResamplerState *>(data);
+    rsm->oldsamples[0] = m_oldsamples[0];
+    rsm->oldsamples[1] = m_oldsamples[1];
+    rsm->samples[0] = m_samples[0];
+    rsm->samples[1] = m_samples[1];
+    rsm->samplecnt = m_samplecnt;
+    data += alignStateSize(sizeof(ResamplerState));
+#endif
+    static_cast<const T *>(this)->nativeSaveState(data);
+}
+
+template <class T>
+void OPNChipBaseT<T>::loadState(const void *state)
+{
+    const uint8_t *data = static_cast<const uint8_t *>(state);
+#if defined(OPNMIDI_ENABLE_HQ_RESAMPLER)
+    // the state of this resampler is not accessible, start it over
+    resetResampler();
+#else
+    const ResamplerState *rsm = reinterpret_cast<const ResamplerState *>(data);
+    m_oldsamples[0] = rsm->oldsamples[0];
+    m_oldsamples[1] = rsm->oldsamples[1];
+    m_samples[0] = rsm->samples[0];
+    m_samples[1] = rsm->samples[1];
+    m_samplecnt = rsm->samplecnt;
+    data += alignStateSize(sizeof(ResamplerState));
+#endif
+    static_cast<T *>(this)->nativeLoadState(data);
+}
+
 template <class T>
 void OPNChipBaseT<T>::nativeTick(int16_t *frame)
 {
@@ -309,6 +485,74 @@ void OPNChipBaseBufferedT<T, Buffer>::reset()
     m_bufferIndex = 0;
 }
 
+template <class T, unsigned Buffer>
+void OPNChipBaseBufferedT<T, Buffer>::generateChannels(int32_t *output[6], size_t frames)
+{
+    // frames are generated directly, drop those which are buffered
+    m_bufferIndex = 0;
+    OPNChipBaseT<T>::generateChannels(output, frames);
+}
+
+template <class T, unsigned Buffer>
+void OPNChipBaseBufferedT<T, Buffer>::generateChannelsFloat(float *output[6], size_t frames)
+{
+    // the same as generateChannels
+    m_bufferIndex = 0;
+    OPNChipBaseT<T>::generateChannelsFloat(output, frames);
+}
+
+template <class T, unsigned Buffer>
+void OPNChipBaseBufferedT<T, Buffer>::nativeGenerateBlock(int16_t *output, size_t frames)
+{
+#if defined(OPNMIDI_AUDIO_TICK_HANDLER)
+    // the tick handler must run before every frame
+    OPNChipBaseT<T>::nativeGenerateBlock(output, frames);
+#else
+    // consume what is left of the buffer first
+    for(; frames > 0 && m_bufferIndex != 0; --frames)
+    {
+        nativeGenerate(output);
+        output += 2;
+    }
+    // then generate in the output, in blocks the size of the buffer
+    while(frames > 0)
+    {
+        size_t count = (frames < (size_t)Buffer) ? frames : (size_t)Buffer;
+        static_cast<T *>(this)->nativeGenerateN(output, count);
+        output += 2 * count;
+        frames -= count;
+    }
+#endif
+}
+
+template <class T, unsigned Buffer>
+size_t OPNChipBaseBufferedT<T, Buffer>::stateSize() const
+{
+    return OPNChipBaseT<T>::alignStateSize(OPNChipBaseT<T>::stateSize()) + sizeof(BufferState);
+}
+
+template <class T, unsigned Buffer>
+void OPNChipBaseBufferedT<T, Buffer>::saveState(void *state) const
+{
+    OPNChipBaseT<T>::saveState(state);
+    uint8_t *data = static_cast<uint8_t *>(state) +
+        OPNChipBaseT<T>::alignStateSize(OPNChipBaseT<T>::stateSize());
+    BufferState *buf = reinterpret_cast<BufferState *>(data);
+    buf->bufferIndex = m_bufferIndex;
+    std::memcpy(buf->buffer, m_buffer, sizeof(m_buffer));
+}
+
+template <class T, unsigned Buffer>
+void OPNChipBaseBufferedT<T, Buffer>::loadState(const void *state)
+{
+    OPNChipBaseT<T>::loadState(state);
+    const uint8_t *data = static_cast<const uint8_t *>(state) +
+        OPNChipBaseT<T>::alignStateSize(OPNChipBaseT<T>::stateSize());
+    const BufferState *buf = reinterpret_cast<const BufferState *>(data);
+    m_bufferIndex = buf->bufferIndex;
+    std::memcpy(m_buffer, buf->buffer, sizeof(m_buffer));
+}
+
 template <class T, unsigned Buffer>
 void OPNChipBaseBufferedT<T, Buffer>::nativeGenerate(int16_t *frame)
 {
@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 #include <stdint.h>
 #include <stdarg.h>
 #include <math.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
 #include "op.h"
@@ -843,6 +844,51 @@ void OPNAReset(OPNA *opna)
     opna->status = 0;
 }
 
+/* ---------------------------------------------------------------------------
+// fmprog: state snapshots. The pointers of a state are into the chip which
+// saved it, they are moved into the chip which loads it.
+*/
+typedef struct
+{
+    const void *base;
+    OPNA opna;
+} OPNAState;
+
+static void *StateRelocate(const void *p, const void *from, void *to)
+{
+    uintptr_t offset = (uintptr_t)p - (uintptr_t)from;
+    if (offset >= sizeof(OPNA))
+        return (void *)p;
+    return (uint8_t *)to + offset;
+}
+
+size_t OPNAStateSize(void)
+{
+    return sizeof(OPNAState);
+}
+
+void OPNASaveState(OPNA *opna, void *state)
+{
+    OPNAState *st = (OPNAState *)state;
+    st->base = opna;
+    memcpy(&st->opna, opna, sizeof(OPNA));
+}
+
+void OPNALoadState(OPNA *opna, const void *state)
+{
+    const OPNAState *st = (const OPNAState *)state;
+    int i, j;
+
+    memcpy(opna, &st->opna, sizeof(OPNA));
+    opna->csmch = (Channel4 *)StateRelocate(opna->csmch, st->base, opna);
+    for (i=0; i<6; i++) {
+        Channel4 *ch = &opna->ch[i];
+        ch->master = (OPNA *)StateRelocate(ch->master, st->base, opna);
+        for (j=0; j<4; j++)
+            ch->op[j].master = (Channel4 *)StateRelocate(ch->op[j].master, st->base, opna);
+    }
+}
+
 /* ---------------------------------------------------------------------------
 // Change OPNA "DAC" samplerate.
 // r and ipflag are as in OPNAInit(), above.
@@ -1286,7 +1332,7 @@ static void Mix6I(OPNA *opna, int32_t *buffer, uint32_t nsamples, int activech)
 // implementation, though another used float and in principle int16_t *should*
 // be sufficient), and be of size at least equal to nsamples.
 */
-static void FMMix(OPNA *opna, int32_t *buffer, uint32_t nsamples)
+static int FMPrepare(OPNA *opna)
 {
     uint32_t j;
     {
@@ -1310,15 +1356,21 @@ static void FMMix(OPNA *opna, int32_t *buffer, uint32_t nsamples)
             act |= (Ch4Prepare(&opna->ch[3]) | ((Ch4Prepare(&opna->ch[4]) | (Ch4Prepare(&opna->ch[5]) << 2)) << 2)) << 6;
         if (!(opna->reg22 & 0x08))
             act &= 0x555;
+        return act;
+    }
+}
 
-        if (act & 0x555) {
-            if (opna->interpolation)
-                Mix6I(opna, buffer, nsamples, act);
-            else
-                Mix6(opna, buffer, nsamples, act);
-        } else {
-            opna->mixl = 0, opna->mixr = 0, opna->mixdelta = 16383;
-        }
+static void FMMix(OPNA *opna, int32_t *buffer, uint32_t nsamples)
+{
+    int act = FMPrepare(opna);
+
+    if (act & 0x555) {
+        if (opna->interpolation)
+            Mix6I(opna, buffer, nsamples, act);
+        else
+            Mix6(opna, buffer, nsamples, act);
+    } else {
+        opna->mixl = 0, opna->mixr = 0, opna->mixdelta = 16383;
     }
 }
 
@@ -1368,3 +1420,35 @@ void OPNAMix(OPNA *opna, int16_t *buf, uint32_t nframes)
     }
     if (clips) message("clipped %u samples\n", clips);
 }
+
+/* ---------------------------------------------------------------------------
+// fmprog: FM channels apart, without panning, at the level of a centered
+// channel in the output of OPNAMix. It runs at the chip samplerate, without
+// interpolation. A NULL buffer skips the channel.
+*/
+void OPNAMixChannels(OPNA *opna, int32_t *buf[6], uint32_t nframes)
+{
+    unsigned int i, c;
+    int act = FMPrepare(opna);
+
+    for (c = 0; c < 6; ++c) {
+        if (buf[c] && !(act & (1 << (c << 1))))
+            memset(buf[c], 0, nframes * sizeof(int32_t));
+    }
+
+    if (!(act & 0x555))
+        return;
+
+    for (i = 0; i < nframes; i++) {
+        if (act & 0xaaa)
+            LFO(opna);
+        for (c = 0; c < 6; ++c) {
+            if (act & (1 << (c << 1))) {
+                int32_t s = Ch4Calc(&opna->ch[c]);
+                s >>= 2; /* libOPNMIDI: prevent FM channel clipping */
+                if (buf[c])
+                    buf[c][i] = (s * 46340 / 65536) >> 2;
+            }
+        }
+    }
+}
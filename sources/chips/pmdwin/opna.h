@@ -2,6 +2,7 @@
 #define __OPNA_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include "op.h"
 #include "psg.h"
 
@@ -66,6 +67,10 @@ extern "C" {
 /* --------------------------------------------------------------------------- */
 uint8_t OPNAInit(OPNA *opna, uint32_t c, uint32_t r, uint8_t ipflag);
 void OPNAReset(OPNA *opna);
+/* fmprog: the state can be loaded in a chip of the same configuration */
+size_t OPNAStateSize(void);
+void OPNASaveState(OPNA *opna, void *state);
+void OPNALoadState(OPNA *opna, const void *state);
 void OPNASetVolumeRhythm(OPNA *opna, int index, int db);
 uint8_t OPNASetRate(OPNA *opna, uint32_t r, uint8_t ipflag);
 void OPNASetChannelMask(OPNA *opna, uint32_t mask);
@@ -73,6 +78,7 @@ void OPNASetReg(OPNA *opna, uint32_t addr, uint32_t data);
 void OPNASetPan(OPNA *opna, uint32_t chan, uint32_t data);
 uint8_t OPNATimerCount(OPNA *opna, int32_t us);
 void OPNAMix(OPNA *opna, int16_t *buffer, uint32_t nframes);
+void OPNAMixChannels(OPNA *opna, int32_t *buffer[6], uint32_t nframes);
 
 /* --------------------------------------------------------------------------- */
 static inline uint32_t OPNAReadStatus(OPNA *opna) { return opna->status & 0x03; }
@@ -51,8 +51,12 @@ void PMDWinOPNA::setRate(uint32_t rate, uint32_t clock)
 void PMDWinOPNA::reset()
 {
     OPNChipBaseBufferedT::reset();
+    // OPNAReset() leaves envelope state behind, which is audible on the
+    // next note; initialize the chip again to make it as good as new
     OPNA *opn = reinterpret_cast<OPNA *>(chip);
-    OPNAReset(opn);
+    uint32_t chipRate = isRunningAtPcmRate() ? m_rate : nativeRate();
+    std::memset(chip, 0, sizeof(*opn));
+    OPNAInit(opn, m_clock, chipRate, 0);
     OPNASetReg(opn, 0x29, 0x9f);
 }
 
@@ -78,6 +82,27 @@ void PMDWinOPNA::nativeGenerateN(int16_t *output, size_t frames)
     OPNAMix(opn, output, static_cast<uint32_t>(frames));
 }
 
+void PMDWinOPNA::nativeGenerateChannels(int32_t *output[6], size_t frames)
+{
+    OPNA *opn = reinterpret_cast<OPNA *>(chip);
+    OPNAMixChannels(opn, output, static_cast<uint32_t>(frames));
+}
+
+size_t PMDWinOPNA::nativeStateSize() const
+{
+    return OPNAStateSize();
+}
+
+void PMDWinOPNA::nativeSaveState(void *state) const
+{
+    OPNASaveState(reinterpret_cast<OPNA *>(chip), state);
+}
+
+void PMDWinOPNA::nativeLoadState(const void *state)
+{
+    OPNALoadState(reinterpret_cast<OPNA *>(chip), state);
+}
+
 const char *PMDWinOPNA::emulatorName()
 {
     return "PMDWin OPNA";  // git 2018-05-11 rev 255ef52
@@ -14,6 +14,7 @@
 #include <QSysInfo>
 #include <QAudioOutput>
 #include <QDebug>
+#include <cstdlib>
 #include <cmath>
 
 int main(int argc, char *argv[])
@@ -36,6 +37,12 @@ void Application::init()
     QCommandLineParser cli;
     cli.addHelpOption();
     cli.addPositionalArgument("audio-file", tr("Reference audio file"));
+    QCommandLineOption populationOption(
+        "population", tr("Number of individuals in the population"), tr("size"));
+    cli.addOption(populationOption);
+    QCommandLineOption seedOption(
+        "seed", tr("Seed of the random generator, for a reproducible run"), tr("number"));
+    cli.addOption(seedOption);
     cli.process(*this);
 
     QStringList optargs = cli.positionalArguments();
@@ -43,15 +50,39 @@ void Application::init()
     if (optargs.size() > 0)
         audiofile = optargs[0];
 
+    unsigned population_size = ai::GeneticData::default_population_size;
+    if (cli.isSet(populationOption)) {
+        bool ok = false;
+        population_size = cli.value(populationOption).toUInt(&ok);
+        if (!ok || population_size < ai::GeneticData::min_population_size ||
+            population_size > ai::GeneticData::max_population_size) {
+            qCritical() << "Invalid population size" << cli.value(populationOption);
+            std::exit(1);
+        }
+    }
+
+    qulonglong seed = 0;
+    if (cli.isSet(seedOption)) {
+        bool ok = false;
+        seed = cli.value(seedOption).toULongLong(&ok);
+        if (!ok) {
+            qCritical() << "Invalid seed" << cli.value(seedOption);
+            std::exit(1);
+        }
+    }
+
     ai::registerQtMetaTypes();
 
     ai::GeneticAlgorithm *ga = new ai::GeneticAlgorithm;
     ga_.reset(ga);
-    ga->set_generation_callback([this](size_t g, const ai::Individual &ind) {
-                                    onGenerationFromOtherThread(g, ind);
-                                });
-    ga->set_fitness_callback([this](size_t g, const ai::FitnessRecord &fitness) {
-                                    onFitnessFromOtherThread(g, fitness);
+    ga->set_population_size(population_size);
+    populationSize_ = population_size;
+    if (cli.isSet(seedOption)) {
+        ga->set_seed(seed);
+        ga->reinitialize();
+    }
+    ga->set_generation_callback([this](size_t, const ai::Individual &) {
+                                    onGenerationFromOtherThread();
                                 });
 
     MainWindow *window = window_ = new MainWindow;
@@ -61,17 +92,18 @@ void Application::init()
     if (!audiofile.isEmpty())
         window->loadAudioFile(audiofile);
 
-    {
-        std::unique_lock<std::mutex> lock;
-        ai::GeneticData &gd = ga->lock(lock);
-        ai::Evaluation &eval = *gd.eval_;
-        eval.set_reference_note(sndMidiPitch_);
-        eval.set_sample_rate(fmSampleRate());
-        gd.population_->clear_evaluation();
-    }
+    unsigned note = sndMidiPitch_;
+    double sample_rate = fmSampleRate();
+    ga->post([note, sample_rate](ai::GeneticData &gd) {
+                 ai::Evaluation &eval = *gd.eval_;
+                 eval.set_reference_note(note);
+                 eval.set_sample_rate(sample_rate);
+                 gd.population_->clear_evaluation();
+             });
 
     emit midiPitchChanged(sndMidiPitch_);
     emit fmChipClockChanged(fmChipClock());
+    emit populationSizeChanged(population_size);
 }
 
 bool Application::loadAudioFile(const QString &filename)
@@ -93,7 +125,7 @@ bool Application::loadAudioFile(const QString &filename)
 
 bool Application::saveFittestInstrument(const QString &filename)
 {
-    FmBank::Instrument ins = currentFittest_.ins_;
+    FmBank::Instrument ins = currentFittest_.instrument();
 
     if (WohlstandOPN2().saveFileInst(filename, ins) != FfmtErrCode::ERR_OK)
         return false;
@@ -103,21 +135,11 @@ bool Application::saveFittestInstrument(const QString &filename)
 
 void Application::playFittestInstrument()
 {
-    FmBank::Instrument ins = currentFittest_.ins_;
-    fvec_u sound;
-    double sample_rate;
-
-    // generate
-    {
-        ai::GeneticAlgorithm &ga = *ga_;
-        bool was_paused = ga.set_paused(true);
-        std::unique_lock<std::mutex> lock;
-        ai::GeneticData &gd = ga.lock(lock);
-        ai::Evaluation &eval = *gd.eval_;
-        sample_rate = eval.sample_rate();
-        sound = ai::Evaluation::generate(ins, eval.reference().length, sample_rate, eval.reference_note());
-        ga.set_paused(was_paused);
-    }
+    FmBank::Instrument ins = currentFittest_.instrument();
+
+    // generate as the algorithm evaluates, with the settings it was given
+    double sample_rate = fmSampleRate();
+    fvec_u sound = ai::Evaluation::generate(ins, referenceLength_, sample_rate, sndMidiPitch_);
 
     playAudio(*sound, sample_rate);
 }
@@ -139,19 +161,26 @@ void Application::setMidiPitch(unsigned key)
 
     sndMidiPitch_ = key;
 
-    {
-        ai::GeneticAlgorithm &ga = *ga_;
-        bool was_paused = ga.set_paused(true);
-        std::unique_lock<std::mutex> lock;
-        ai::GeneticData &gd = ga.lock(lock);
-        gd.eval_->set_reference_note(key);
-        gd.population_->clear_evaluation();
-        ga.set_paused(was_paused);
-    }
+    ga_->post([key](ai::GeneticData &gd) {
+                  gd.eval_->set_reference_note(key);
+                  gd.population_->clear_evaluation();
+              });
 
     emit midiPitchChanged(key);
 }
 
+void Application::setPopulationSize(unsigned size)
+{
+    size = std::max<unsigned>(size, ai::GeneticData::min_population_size);
+    size = std::min<unsigned>(size, ai::GeneticData::max_population_size);
+    if (populationSize_ == size)
+        return;
+
+    populationSize_ = size;
+    ga_->set_population_size(size);
+    emit populationSizeChanged(size);
+}
+
 void Application::startAi()
 {
     ai::GeneticAlgorithm &ga = *ga_;
@@ -231,16 +260,15 @@ void Application::resampleSound()
     double dst_rate = fmSampleRate();
 
     fvec_u dst(resample_sound(src, src_rate, dst_rate));
-
-    {
-        ai::GeneticAlgorithm &ga = *ga_;
-        bool was_paused = ga.set_paused(true);
-        std::unique_lock<std::mutex> lock;
-        ai::GeneticData &gd = ga.lock(lock);
-        gd.eval_->set_reference(std::move(dst));
-        gd.population_->clear_evaluation();
-        ga.set_paused(was_paused);
-    }
+    referenceLength_ = dst->length;
+
+    // the command is copyable, it holds the sound by a shared pointer
+    std::shared_ptr<fvec_u> reference = std::make_shared<fvec_u>(std::move(dst));
+    ga_->post([reference, dst_rate](ai::GeneticData &gd) {
+                  gd.eval_->set_sample_rate(dst_rate);
+                  gd.eval_->set_reference(std::move(*reference));
+                  gd.population_->clear_evaluation();
+              });
 }
 
 void Application::detectPitch()
@@ -249,27 +277,24 @@ void Application::detectPitch()
     setMidiPitch(key);
 }
 
-void Application::onGenerationFromOtherThread(size_t generation_num, const ai::Individual &fittest)
+void Application::onGenerationFromOtherThread()
 {
-    QMetaObject::invokeMethod(this, "onGeneration", Qt::QueuedConnection,
-                              Q_ARG(ulong, generation_num), Q_ARG(ai::Individual, fittest));
+    // the latest snapshot is shown, notify once until then
+    if (!generationPending_.exchange(true))
+        QMetaObject::invokeMethod(this, "onGeneration", Qt::QueuedConnection);
 }
 
-void Application::onFitnessFromOtherThread(size_t generation_num, const ai::FitnessRecord &fitness)
+void Application::onGeneration()
 {
-    QMetaObject::invokeMethod(this, "onFitness", Qt::QueuedConnection,
-                              Q_ARG(ulong, generation_num), Q_ARG(ai::FitnessRecord, fitness));
-}
+    generationPending_ = false;
+    std::shared_ptr<const ai::Snapshot> snapshot = ga_->snapshot();
+    if (!snapshot)
+        return;
 
-void Application::onGeneration(ulong generation_num, const ai::Individual fittest)
-{
-    window_->updateGenerationNumber(generation_num);
-    currentFittest_ = fittest;
-    window_->instrumentEditor()->setValuesFromInstrument(fittest.ins_);
-}
+    window_->updateGenerationNumber(snapshot->generation_num_);
+    currentFittest_ = snapshot->fittest_;
+    window_->instrumentEditor()->setValuesFromInstrument(currentFittest_.instrument());
 
-void Application::onFitness(ulong generation_num, ai::FitnessRecord fitness)
-{
+    // the fitness of the generation is in snapshot->fitness_
     #pragma message("TODO implement fitness display")
-    //qDebug() << "Fitness";
 }
@@ -3,10 +3,10 @@
 #include "ai/algorithm_data.h"
 #include "utility/aubio++.h"
 #include <QApplication>
+#include <atomic>
 #include <cstdint>
 
 namespace ai { class GeneticAlgorithm; }
-namespace ai { struct FitnessRecord; }
 class MainWindow;
 class QAudioOutput;
 
@@ -23,6 +23,7 @@ public:
     void playFittestInstrument();
     void setFmChipClock(unsigned clock);
     void setMidiPitch(unsigned key);
+    void setPopulationSize(unsigned size);
 
     void startAi();
     void setPausedAi(bool paused);
@@ -37,17 +38,16 @@ public:
 signals:
     void midiPitchChanged(unsigned key);
     void fmChipClockChanged(unsigned clock);
+    void populationSizeChanged(unsigned size);
 
 private:
     void playAudio(const fvec_t &sound, double sample_rate);
     void resampleSound();
     void detectPitch();
-    void onGenerationFromOtherThread(size_t generation_num, const ai::Individual &fittest);
-    void onFitnessFromOtherThread(size_t generation_num, const ai::FitnessRecord &fitness);
+    void onGenerationFromOtherThread();
 
 private slots:
-    void onGeneration(ulong generation_num, const ai::Individual fittest);
-    void onFitness(ulong generation_num, ai::FitnessRecord fitness);
+    void onGeneration();
 
 private:
     MainWindow *window_ = nullptr;
@@ -56,9 +56,12 @@ private:
     fvec_u sndOriginal_;
     unsigned sampleRateOriginal_ = 44100;
     unsigned sndMidiPitch_ = 69;
+    unsigned referenceLength_ = 1;
+    unsigned populationSize_ = 0;
 
     std::unique_ptr<ai::GeneticAlgorithm> ga_;
     ai::Individual currentFittest_;
+    std::atomic<bool> generationPending_{false};
 
     QAudioOutput *audioOut_ = nullptr;
     QByteArray audioOutData_;
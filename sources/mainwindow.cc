@@ -19,6 +19,7 @@ MainWindow::MainWindow(QWidget *parent)
     Application &app = static_cast<Application &>(*qApp);
     connect(&app, &Application::midiPitchChanged, this, &MainWindow::updateMidiPitch);
     connect(&app, &Application::fmChipClockChanged, this, &MainWindow::updateFmChipClock);
+    connect(&app, &Application::populationSizeChanged, this, &MainWindow::updatePopulationSize);
 }
 
 MainWindow::~MainWindow()
@@ -45,6 +46,11 @@ void MainWindow::updateFmChipClock(unsigned clock)
     ui_->fmClockComboBox->setCurrentIndex(ui_->fmClockComboBox->findData(clock));
 }
 
+void MainWindow::updatePopulationSize(unsigned size)
+{
+    ui_->populationSpinBox->setValue(size);
+}
+
 void MainWindow::loadAudioFile(const QString &filename)
 {
     Application &app = static_cast<Application &>(*qApp);
@@ -139,3 +145,9 @@ void MainWindow::on_fmClockComboBox_currentIndexChanged(int index)
     Application &app = static_cast<Application &>(*qApp);
     app.setFmChipClock(ui_->fmClockComboBox->itemData(index).toUInt());
 }
+
+void MainWindow::on_populationSpinBox_valueChanged(int value)
+{
+    Application &app = static_cast<Application &>(*qApp);
+    app.setPopulationSize(value);
+}
@@ -19,6 +19,7 @@ public:
 public slots:
     void updateMidiPitch(unsigned key);
     void updateFmChipClock(unsigned clock);
+    void updatePopulationSize(unsigned size);
     void loadAudioFile(const QString &filename);
     bool saveInstrumentFile();
 
@@ -36,6 +37,7 @@ private slots:
     void on_resetButton_clicked();
     void on_pitchComboBox_currentIndexChanged(int index);
     void on_fmClockComboBox_currentIndexChanged(int index);
+    void on_populationSpinBox_valueChanged(int value);
 
 private:
     std::unique_ptr<Ui::MainWindow> ui_;
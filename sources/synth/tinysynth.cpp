@@ -42,19 +42,8 @@ void TinySynth::resetChip()
     m_chip->writeReg(0, 0x2B, 0x0 );   //DAC off
 }
 
-void TinySynth::setInstrument(const FmBank::Instrument &in)
+void TinySynth::setupPatch(const FmBank::Instrument &in, OPN_PatchSetup &patch)
 {
-    OPN_PatchSetup &patch = m_patch;
-
-    // m_notenum = in.percNoteNum >= 128 ? (in.percNoteNum - 128) : in.percNoteNum;
-    // if(m_notenum == 0)
-    //     m_notenum = 25;
-
-    m_notesNum = 1;
-    m_fineTune = 0;
-    m_noteOffsets[0] = in.note_offset1;
-    //m_noteOffsets[1] = in.note_offset2;
-
     for(int op = 0; op < 4; op++)
     {
         patch.OPS[op].data[0] = in.getRegDUMUL(op);
@@ -69,8 +58,29 @@ void TinySynth::setInstrument(const FmBank::Instrument &in)
     patch.lfosens  = in.getRegLfoSens();
     patch.finetune = static_cast<int8_t>(in.note_offset1);
     patch.tone     = 0;
+}
+
+void TinySynth::setInstrument(const FmBank::Instrument &in)
+{
+    setInstrument(in, 0);
+}
+
+void TinySynth::setInstrument(const FmBank::Instrument &in, uint32_t channel)
+{
+    OPN_PatchSetup &patch = m_patch;
+
+    // m_notenum = in.percNoteNum >= 128 ? (in.percNoteNum - 128) : in.percNoteNum;
+    // if(m_notenum == 0)
+    //     m_notenum = 25;
+
+    m_notesNum = 1;
+    m_fineTune = 0;
+    m_noteOffsets[0] = in.note_offset1;
+    //m_noteOffsets[1] = in.note_offset2;
+
+    setupPatch(in, patch);
 
-    m_c = 0;
+    m_c = channel;
     m_port = (m_c <= 2) ? 0 : 1;
     m_cc   = m_c % 3;
 
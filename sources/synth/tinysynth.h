@@ -65,7 +65,11 @@ struct TinySynth
     OPN_PatchSetup m_patch;
 
     void resetChip();
+    //! Compute the register data which sets up the instrument
+    static void setupPatch(const FmBank::Instrument &in, OPN_PatchSetup &patch);
     void setInstrument(const FmBank::Instrument &in);
+    //! Set the instrument on a given channel of the chip (0-5)
+    void setInstrument(const FmBank::Instrument &in, uint32_t channel);
     void noteOn();
     void noteOff();
     void generate(int16_t *output, size_t frames);
@@ -53,16 +53,16 @@ int main(int argc, char *argv[])
             fclose(fh);
         }
         if (1) {
-            std::vector<fvec_u> ref_coeffs = ai::Evaluation::compute_mfcc_coeffs(ref_sound, sample_rate);
-            std::vector<fvec_u> syn_coeffs = ai::Evaluation::compute_mfcc_coeffs(syn_sound.get(), sample_rate);
-            unsigned num_windows = ref_coeffs.size();
+            ai::FeatureMatrix ref_coeffs = ai::Evaluation::compute_mfcc_coeffs(ref_sound, sample_rate);
+            ai::FeatureMatrix syn_coeffs = ai::Evaluation::compute_mfcc_coeffs(syn_sound.get(), sample_rate);
+            unsigned num_windows = ref_coeffs.rows();
             FILE *fh = fopen("/tmp/mfcc.dat", "w");
             for (unsigned idx_window = 0; idx_window < num_windows; ++idx_window) {
-                unsigned num_coeffs = ref_coeffs[idx_window]->length;
+                unsigned num_coeffs = ref_coeffs.cols();
                 for (unsigned idx_coeff = 0; idx_coeff < num_coeffs; ++idx_coeff)
                     fprintf(fh, "%u %u %f %f\n", idx_window, idx_coeff,
-                            ref_coeffs[idx_window]->data[idx_coeff],
-                            syn_coeffs[idx_window]->data[idx_coeff]);
+                            ref_coeffs.row(idx_window)[idx_coeff],
+                            syn_coeffs.row(idx_window)[idx_coeff]);
             }
             fclose(fh);
         }
@@ -0,0 +1,161 @@
+#include "chips/np2_opna.h"
+#include "chips/lanes_opna.h"
+#include "synth/tinysynth.h"
+#include <random>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+// The FM Lanes engine is a port of fmgen, it is compared with fmgen on
+// random instruments, which play on the 6 channels at once: the outputs
+// must match to the sample.
+
+static FmBank::Instrument random_instrument(std::mt19937 &prng)
+{
+    auto between = [&prng](int min, int max) -> uint8_t {
+        return (uint8_t)std::uniform_int_distribution<int>(min, max)(prng);
+    };
+
+    FmBank::Instrument ins = FmBank::emptyInst();
+    ins.algorithm = between(0, 7);
+    ins.feedback = between(0, 7);
+    ins.am = between(0, 3);
+    ins.fm = between(0, 7);
+    for (FmBank::Operator &op : ins.OP) {
+        op.detune = between(0, 7);
+        op.fmult = between(0, 15);
+        op.level = between(0, 63);
+        op.ratescale = between(0, 3);
+        op.attack = between(12, 31);
+        op.am_enable = between(0, 1);
+        op.decay1 = between(0, 31);
+        op.decay2 = between(0, 31);
+        op.sustain = between(0, 15);
+        op.ssg_eg = between(0, 3) ? 0 : between(8, 15);
+        op.release = between(0, 15);
+    }
+    return ins;
+}
+
+struct Setup
+{
+    OPNFamily family;
+    unsigned rate;
+    bool pcm_rate;
+    unsigned lfo;
+    unsigned note;
+    FmBank::Instrument ins[6];
+};
+
+static void start(OPNChipBase &chip, const Setup &setup)
+{
+    chip.setRunningAtPcmRate(setup.pcm_rate);
+    chip.setRate(setup.rate, chip.nativeClockRate());
+
+    TinySynth synth;
+    std::memset(&synth, 0, sizeof(TinySynth));
+    synth.m_chip = &chip;
+    chip.writeReg(0, 0x22, (uint8_t)setup.lfo);
+    for (unsigned c = 0; c < 6; ++c) {
+        synth.m_notenum = (int)(setup.note + 7 * c);
+        synth.setInstrument(setup.ins[c], c);
+        synth.noteOn();
+    }
+}
+
+static void stop(OPNChipBase &chip)
+{
+    for (unsigned c = 0; c < 6; ++c)
+        chip.writeReg(0, 0x28, (uint8_t)((c < 3) ? c : (c + 1)));
+}
+
+// the number of samples which differ
+static size_t compare(const char *what, const int32_t *a, const int32_t *b, size_t count)
+{
+    size_t diffs = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (a[i] != b[i] && diffs++ == 0)
+            fprintf(stderr, "%s: differs at %zu, %d != %d\n", what, i, (int)a[i], (int)b[i]);
+    }
+    return diffs;
+}
+
+static size_t test_channels(const Setup &setup, size_t frames)
+{
+    NP2OPNA<> ref(setup.family);
+    LanesOPNA chip(setup.family);
+    start(ref, setup);
+    start(chip, setup);
+
+    std::vector<int32_t> ref_out(6 * frames), out(6 * frames);
+    size_t diffs = 0;
+    for (unsigned part = 0; part < 2; ++part) {
+        int32_t *ref_channels[6], *channels[6];
+        for (unsigned c = 0; c < 6; ++c) {
+            ref_channels[c] = &ref_out[c * frames];
+            channels[c] = &out[c * frames];
+        }
+        ref.generateChannels(ref_channels, frames);
+        chip.generateChannels(channels, frames);
+        diffs += compare("channels", ref_out.data(), out.data(), 6 * frames);
+        stop(ref);
+        stop(chip);
+    }
+    return diffs;
+}
+
+static size_t test_stereo(const Setup &setup, size_t frames)
+{
+    NP2OPNA<> ref(setup.family);
+    LanesOPNA chip(setup.family);
+    start(ref, setup);
+    start(chip, setup);
+
+    std::mt19937 prng(setup.note);
+    for (unsigned c = 0; c < 6; ++c) {
+        uint8_t pan = (uint8_t)std::uniform_int_distribution<int>(0, 127)(prng);
+        ref.writePan(c, pan);
+        chip.writePan(c, pan);
+    }
+
+    std::vector<int16_t> ref_out(2 * frames), out(2 * frames);
+    size_t diffs = 0;
+    for (unsigned part = 0; part < 2; ++part) {
+        ref.generate(ref_out.data(), frames);
+        chip.generate(out.data(), frames);
+        std::vector<int32_t> a(ref_out.begin(), ref_out.end()), b(out.begin(), out.end());
+        diffs += compare("stereo", a.data(), b.data(), 2 * frames);
+        stop(ref);
+        stop(chip);
+    }
+    return diffs;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned count = (argc > 1) ? (unsigned)std::atoi(argv[1]) : 100;
+
+    std::mt19937 prng(1);
+    size_t failures = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        Setup setup;
+        setup.family = (i & 1) ? OPNChip_OPNA : OPNChip_OPN2;
+        setup.pcm_rate = (i % 3) == 2;
+        setup.rate = setup.pcm_rate ? 44100 : opn2_getNativeRate(setup.family);
+        setup.lfo = (i & 2) ? (0x08 | (i >> 2 & 7)) : 0;
+        setup.note = 36 + i % 24;
+        for (FmBank::Instrument &ins : setup.ins)
+            ins = random_instrument(prng);
+
+        size_t frames = 4000 + 1000 * (i % 5);
+        size_t diffs = test_channels(setup, frames) + test_stereo(setup, frames);
+        if (diffs > 0) {
+            fprintf(stderr, "case %u: %zu samples differ\n", i, diffs);
+            ++failures;
+        }
+    }
+
+    printf("%zu/%u cases differ\n", failures, count);
+    return (failures > 0) ? 1 : 0;
+}
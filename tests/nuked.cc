@@ -0,0 +1,288 @@
+#include "chips/nuked/ym3438.h"
+#include "chips/nuked_opn2.h"
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+
+// OPN2_GenerateBlock renders the samples of OPN2_Generate by blocks; two
+// chips are given the same register stream, with muted channels, the DAC
+// and writes still in the buffer when a block starts, and one renders it
+// sample by sample, the other by blocks: the outputs must match to the
+// sample, and the chips must end in the same state.
+//
+// OPN2_WriteDirect applies the setup of a patch before it returns: the
+// registers must hold what the same writes leave once they are out of the
+// buffer, and the keys be on when the notes start. A chip loaded from a
+// state, with writes still in its buffer, then given direct writes, must
+// render the same every time.
+
+// the chip which renders by samples, and the one which renders by blocks
+struct Pair
+{
+    std::unique_ptr<ym3438_t> ref{new ym3438_t}, chip{new ym3438_t};
+};
+
+static void write_buffered(Pair &pair, unsigned port, unsigned addr, unsigned data)
+{
+    for (ym3438_t *chip : {pair.ref.get(), pair.chip.get()}) {
+        OPN2_WriteBuffered(chip, 0 + port * 2, (Bit8u)addr);
+        OPN2_WriteBuffered(chip, 1 + port * 2, (Bit8u)data);
+    }
+}
+
+// a random write to the FM registers, to the DAC or to a key
+static void random_write(Pair &pair, std::mt19937 &prng)
+{
+    auto between = [&prng](unsigned min, unsigned max) -> unsigned {
+        return std::uniform_int_distribution<unsigned>(min, max)(prng);
+    };
+
+    unsigned port = between(0, 1);
+    switch (between(0, 7)) {
+    case 0:
+        write_buffered(pair, 0, 0x28, (between(0, 15) << 4) | between(0, 6));
+        break;
+    case 1:
+        write_buffered(pair, 0, 0x2a, between(0, 255));
+        break;
+    case 2:
+        write_buffered(pair, port, 0xa4 + between(0, 2), between(0, 0x3f));
+        write_buffered(pair, port, 0xa0 + between(0, 2), between(0, 255));
+        break;
+    case 3:
+        write_buffered(pair, port, 0xb0 + between(0, 2), between(0, 0x3f));
+        break;
+    case 4:
+        write_buffered(pair, port, 0xb4 + between(0, 2), between(0, 255));
+        break;
+    default:
+        write_buffered(pair, port, between(0x30, 0x9f), between(0, 255));
+        break;
+    }
+}
+
+static size_t test_stream(unsigned seed, size_t frames)
+{
+    Pair pair;
+    ym3438_t *ref = pair.ref.get(), *chip = pair.chip.get();
+    std::memset(ref, 0, sizeof(ym3438_t));
+    std::memset(chip, 0, sizeof(ym3438_t));
+    OPN2_Reset(ref, 0, 7670454);
+    OPN2_Reset(chip, 0, 7670454);
+
+    std::mt19937 prng(seed);
+    auto between = [&prng](unsigned min, unsigned max) -> unsigned {
+        return std::uniform_int_distribution<unsigned>(min, max)(prng);
+    };
+
+    for (unsigned i = 0; i < 200; ++i)
+        random_write(pair, prng);
+    write_buffered(pair, 0, 0x28, 0xf0);
+
+    std::vector<Bit16s> ref_out(2 * frames), out(2 * frames);
+    size_t done = 0;
+    while (done < frames) {
+        size_t count = std::min<size_t>(between(1, 300), frames - done);
+
+        // settings applied at once, between blocks
+        unsigned mute = between(0, 3) ? 0 : between(0, 127);
+        OPN2_SetMute(ref, mute);
+        OPN2_SetMute(chip, mute);
+        if (between(0, 3) == 0) {
+            unsigned channel = between(0, 5), pan = between(0, 127);
+            OPN2_WritePan(ref, channel, (Bit8u)pan);
+            OPN2_WritePan(chip, channel, (Bit8u)pan);
+        }
+
+        // writes which are buffered when the block starts
+        if (between(0, 1))
+            write_buffered(pair, 0, 0x2b, between(0, 1) << 7);
+        for (unsigned i = 0, n = between(0, 20); i < n; ++i)
+            random_write(pair, prng);
+
+        for (size_t i = 0; i < count; ++i)
+            OPN2_Generate(ref, &ref_out[2 * (done + i)]);
+        OPN2_GenerateBlock(chip, &out[2 * done], (Bit32u)count);
+        done += count;
+    }
+
+    size_t diffs = 0;
+    for (size_t i = 0; i < 2 * frames; ++i) {
+        if (ref_out[i] != out[i] && diffs++ == 0)
+            fprintf(stderr, "stream %u: differs at %zu, %d != %d\n", seed, i, (int)ref_out[i], (int)out[i]);
+    }
+    if (std::memcmp(ref, chip, sizeof(ym3438_t)) != 0) {
+        fprintf(stderr, "stream %u: the states differ\n", seed);
+        ++diffs;
+    }
+    return diffs;
+}
+
+struct Write
+{
+    unsigned port, addr, data;
+};
+
+// the registers of random patches on the 6 channels, key-off included
+static std::vector<Write> patch_writes(std::mt19937 &prng)
+{
+    auto between = [&prng](unsigned min, unsigned max) -> unsigned {
+        return std::uniform_int_distribution<unsigned>(min, max)(prng);
+    };
+
+    std::vector<Write> writes;
+    writes.push_back({0, 0x22, between(0, 15)});
+    for (unsigned port = 0; port < 2; ++port) {
+        for (unsigned c = 0; c < 3; ++c) {
+            writes.push_back({0, 0x28, port * 4 + c});
+            for (unsigned addr = 0x30; addr < 0xa0; addr += 4) {
+                // audible: a low total level, a fast attack
+                unsigned data = between(0, 255);
+                if (addr >= 0x40 && addr < 0x50)
+                    data &= 0x1f;
+                else if (addr >= 0x50 && addr < 0x60)
+                    data |= 0x1c;
+                writes.push_back({port, addr + c, data});
+            }
+            writes.push_back({port, 0xa4 + c, between(0, 0x3f)});
+            writes.push_back({port, 0xa0 + c, between(0, 255)});
+            writes.push_back({port, 0xb0 + c, between(0, 0x3f)});
+            writes.push_back({port, 0xb4 + c, 0xc0 | between(0, 0x3f)});
+        }
+    }
+    return writes;
+}
+
+static const Write key_on[6] = {
+    {0, 0x28, 0xf0}, {0, 0x28, 0xf1}, {0, 0x28, 0xf2},
+    {0, 0x28, 0xf4}, {0, 0x28, 0xf5}, {0, 0x28, 0xf6},
+};
+
+// the registers of the operators and channels, from `ks` to `pms`
+static bool same_registers(const ym3438_t *a, const ym3438_t *b)
+{
+    size_t begin = offsetof(ym3438_t, ks);
+    size_t end = offsetof(ym3438_t, status);
+    return std::memcmp((const char *)a + begin, (const char *)b + begin, end - begin) == 0;
+}
+
+static size_t test_direct_setup(unsigned seed)
+{
+    std::unique_ptr<ym3438_t> ref(new ym3438_t), chip(new ym3438_t);
+    std::memset(ref.get(), 0, sizeof(ym3438_t));
+    std::memset(chip.get(), 0, sizeof(ym3438_t));
+    OPN2_Reset(ref.get(), 0, 7670454);
+    OPN2_Reset(chip.get(), 0, 7670454);
+
+    std::mt19937 prng(seed);
+    size_t diffs = 0;
+
+    // the buffered writes are rendered until they are all out
+    for (const Write &w : patch_writes(prng)) {
+        OPN2_WriteBuffered(ref.get(), 0 + w.port * 2, (Bit8u)w.addr);
+        OPN2_WriteBuffered(ref.get(), 1 + w.port * 2, (Bit8u)w.data);
+        OPN2_WriteDirect(chip.get(), 0 + w.port * 2, (Bit8u)w.addr);
+        OPN2_WriteDirect(chip.get(), 1 + w.port * 2, (Bit8u)w.data);
+    }
+    Bit16s frame[2];
+    while (ref->writebuf[ref->writebuf_cur].port & 0x04)
+        OPN2_Generate(ref.get(), frame);
+    OPN2_Generate(ref.get(), frame);
+
+    if (!same_registers(ref.get(), chip.get())) {
+        fprintf(stderr, "setup %u: the registers differ\n", seed);
+        ++diffs;
+    }
+
+    for (const Write &w : key_on) {
+        OPN2_WriteDirect(chip.get(), 0 + w.port * 2, (Bit8u)w.addr);
+        OPN2_WriteDirect(chip.get(), 1 + w.port * 2, (Bit8u)w.data);
+    }
+    for (unsigned slot = 0; slot < 24; ++slot) {
+        if (!chip->mode_kon[slot]) {
+            fprintf(stderr, "setup %u: the key of slot %u is off\n", seed, slot);
+            ++diffs;
+        }
+    }
+    return diffs;
+}
+
+static void write_all(NukedOPN2 &chip, const Write *writes, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        chip.writeReg(writes[i].port, (uint16_t)writes[i].addr, (uint8_t)writes[i].data);
+}
+
+static size_t test_direct_restore(unsigned seed, size_t frames)
+{
+    std::mt19937 prng(seed);
+
+    // a state taken with writes still in the buffer
+    NukedOPN2 source(OPNChip_OPN2);
+    source.setRate(opn2_getNativeRate(OPNChip_OPN2), opn2_getNativeClockRate(OPNChip_OPN2));
+    std::vector<Write> writes = patch_writes(prng);
+    write_all(source, writes.data(), writes.size());
+    write_all(source, key_on, 6);
+    std::vector<int16_t> out(2 * frames);
+    source.generate(out.data(), 100);
+    writes = patch_writes(prng);
+    write_all(source, writes.data(), writes.size() / 2);
+    std::vector<uint8_t> state(source.stateSize());
+    source.saveState(state.data());
+
+    // a new patch over the restored state, twice
+    writes = patch_writes(prng);
+    std::vector<int16_t> first(2 * frames);
+    size_t diffs = 0;
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        NukedOPN2 chip(OPNChip_OPN2);
+        chip.setRate(opn2_getNativeRate(OPNChip_OPN2), opn2_getNativeClockRate(OPNChip_OPN2));
+        chip.loadState(state.data());
+        chip.setDirectWrites(true);
+        write_all(chip, writes.data(), writes.size());
+        write_all(chip, key_on, 6);
+        chip.setDirectWrites(false);
+        chip.generate(out.data(), frames);
+        if (pass == 0) {
+            first = out;
+            continue;
+        }
+        for (size_t i = 0; i < 2 * frames; ++i) {
+            if (first[i] != out[i] && diffs++ == 0)
+                fprintf(stderr, "restore %u: differs at %zu, %d != %d\n", seed, i, (int)first[i], (int)out[i]);
+        }
+    }
+
+    bool audible = false;
+    for (int16_t sample : first)
+        audible = audible || sample != 0;
+    if (!audible) {
+        fprintf(stderr, "restore %u: the output is silent\n", seed);
+        ++diffs;
+    }
+    return diffs;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned count = (argc > 1) ? (unsigned)std::atoi(argv[1]) : 50;
+
+    size_t failures = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        size_t frames = 4000 + 1000 * (i % 5);
+        size_t diffs = test_stream(i + 1, frames) +
+            test_direct_setup(i + 1) + test_direct_restore(i + 1, frames);
+        if (diffs > 0) {
+            fprintf(stderr, "case %u: %zu samples differ\n", i, diffs);
+            ++failures;
+        }
+    }
+
+    printf("%zu/%u cases differ\n", failures, count);
+    return (failures > 0) ? 1 : 0;
+}
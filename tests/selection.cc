@@ -0,0 +1,54 @@
+#include "ai/ai.h"
+#include <vector>
+#include <cstdio>
+
+// The evaluations of a generation are cut short at the worst survivor of
+// the previous one; the result of an evaluation cut short is an upper
+// limit, which can be close to that bound. It must not take part in the
+// selection as a score: an aborted member ranks below a member which was
+// fully evaluated, even one with a worse result.
+
+static unsigned failures = 0;
+
+static void check(bool cond, const char *what)
+{
+    if (!cond) {
+        fprintf(stderr, "failed: %s\n", what);
+        ++failures;
+    }
+}
+
+int main()
+{
+    ai::Xoshiro256 prng(1);
+    ai::Population pop = ai::Population::create_random(4, prng);
+
+    // survivors of the last generation, and the bound they give
+    pop.set_evaluation(0, 10.0);
+    pop.set_evaluation(1, 8.0);
+    const double bound = 8.0;
+
+    // a child cut short just below the bound, and a worse one evaluated
+    check(pop.set_evaluation(2, 0.99 * bound, false), "aborted member is recorded");
+    check(pop.set_evaluation(3, 3.0, true), "complete member is recorded");
+
+    check(pop.get_status(2) == ai::Population::Unevaluated, "aborted member is not evaluated");
+    check(pop.get_status(3) == ai::Population::Evaluated, "complete member is evaluated");
+    check(pop.get_evaluation(2) < pop.get_evaluation(3), "aborted member ranks below");
+
+    std::vector<double> fitness(pop.capacity());
+    size_t fittest = pop.compute_fitness(fitness.data());
+    check(fittest == 0, "fittest member");
+    check(fitness[2] < fitness[3], "aborted member is less fit");
+    check(fitness[2] < 1.0, "aborted member does not survive");
+    // the average is of the evaluated results only, 21 / 4
+    check(fitness[0] == 10.0 / (21.0 / 4), "average is not inflated");
+
+    // an absent member is not recorded either way
+    pop.remove_member(3);
+    check(!pop.set_evaluation(3, 3.0, false), "absent member is not recorded");
+    check(pop.get_status(3) == ai::Population::Absent, "absent member stays absent");
+
+    printf("%u failures\n", failures);
+    return (failures > 0) ? 1 : 0;
+}